@@ -0,0 +1,135 @@
+#ifndef _FIRST_TOUCH_H_
+#define _FIRST_TOUCH_H_
+
+//
+// Allocation of large benchmark arrays with control over where their
+// pages land.
+//
+// Linux places a page on the NUMA node of the thread that first writes
+// it.  Arrays allocated and initialized on the main thread therefore sit
+// on one node, and task versions running on every socket all pull from
+// that node's memory.  allocFirstTouch instead has one thread per
+// hardware thread, each pinned to its CPU, write a contiguous share of
+// the array, so that the array spreads over the nodes in proportion to
+// their threads.  This only approximates where the *_withtasks kernels
+// read: their spans are smaller than these shares and their unpinned
+// workers take tasks in whatever order they get to them, so what it buys
+// is that every node serves about its share of the traffic, not that
+// every access is local.
+//
+// With hugePages the array is aligned to 2 MB and marked for transparent
+// huge pages, which cuts TLB misses on 80 MB streams.  It only takes
+// effect if /sys/kernel/mm/transparent_hugepage/enabled allows madvise.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#  include <pthread.h>
+#  include <sched.h>
+#  include <sys/mman.h>
+#endif
+
+enum TouchPolicy { TOUCH_SERIAL, TOUCH_PARALLEL };
+
+static const size_t kSmallPage = 4096;
+static const size_t kHugePage = 2 * 1024 * 1024;
+
+#if defined(__linux__)
+// The (index % count)-th of the count CPUs this process may run on, or -1
+// if the system does not say.  In a container or under taskset these are
+// not necessarily CPUs 0 .. count-1.
+static inline int nthAllowedCpu(int index)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return -1;
+    int count = CPU_COUNT(&allowed);
+    if (count == 0)
+        return -1;
+    index %= count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &allowed) && index-- == 0)
+            return cpu;
+    return -1;
+}
+#endif
+
+//
+// allocFirstTouch --
+//
+// Returns n elements, element i set to init(i), placed according to
+// touch.  Release with free().
+template <typename T, typename Init>
+T* allocFirstTouch(size_t n, TouchPolicy touch, bool hugePages, Init init)
+{
+    size_t page = hugePages ? kHugePage : kSmallPage;
+    size_t bytes = (std::max<size_t>(n, 1) * sizeof(T) + page - 1) / page * page;
+    T* data = static_cast<T*>(aligned_alloc(page, bytes));
+    if (!data)
+        return NULL;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (hugePages)
+        madvise(data, bytes, MADV_HUGEPAGE);
+#endif
+
+    if (touch == TOUCH_SERIAL) {
+        for (size_t i = 0; i < n; i++)
+            data[i] = init(i);
+        return data;
+    }
+
+    // one contiguous, page-aligned share per thread
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t perPage = page / sizeof(T);
+    size_t chunk = ((n + numThreads - 1) / numThreads + perPage - 1) / perPage * perPage;
+
+    // an unpinned thread still writes its share, just on whichever node
+    // the scheduler runs it
+    std::atomic<int> unpinned(0);
+    auto worker = [&](int thread) {
+#if defined(__linux__)
+        int cpu = nthAllowedCpu(thread);
+        bool pinned = false;
+        if (cpu >= 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            pinned = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+        }
+        if (!pinned)
+            unpinned++;
+#endif
+        size_t begin = std::min(n, thread * chunk);
+        size_t end = std::min(n, begin + chunk);
+        for (size_t i = begin; i < end; i++)
+            data[i] = init(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++)
+        threads.push_back(std::thread(worker, t));
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    if (unpinned > 0)
+        fprintf(stderr, "Warning: could not pin %d of %d first-touch threads; "
+                "page placement follows the scheduler for their shares\n",
+                unpinned.load(), numThreads);
+
+    return data;
+}
+
+template <typename T>
+T* allocFirstTouch(size_t n, TouchPolicy touch, bool hugePages)
+{
+    return allocFirstTouch<T>(n, touch, hugePages, [](size_t) { return T(); });
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _TASK_SPAN_H_
+#define _TASK_SPAN_H_
+
+//
+// Choosing how many elements each task of an ISPC *_withtasks kernel
+// handles.
+//
+
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+
+// tasks per hardware thread when nothing else is asked for
+#define DEFAULT_OVERSUBSCRIPTION 4
+
+// L2 size in bytes, or 1 MB where the system does not say
+static inline long l2CacheBytes()
+{
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+    long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (bytes > 0)
+        return bytes;
+#endif
+    return 1 << 20;
+}
+
+//
+// chooseTaskSpan --
+//
+// Elements per task for a kernel over N elements that touches
+// bytesPerElement bytes of memory per element.  Spans are small enough
+// that every hardware thread gets about oversubscription tasks, so a slow
+// task does not hold up the end of the launch, and small enough that a
+// task's data fits in half of L2.  They are rounded up to 16 elements so
+// that every task starts on a 64-byte line.  The kernel launches
+// (N + span - 1) / span tasks, the last one taking the remainder.
+static inline int chooseTaskSpan(int N, int bytesPerElement, int oversubscription)
+{
+    long numThreads = std::max(1u, std::thread::hardware_concurrency());
+    long numTasks = numThreads * std::max(1, oversubscription);
+
+    long span = (N + numTasks - 1) / numTasks;
+    span = std::min(span, l2CacheBytes() / 2 / bytesPerElement);
+    span = (span + 15) / 16 * 16;
+    return static_cast<int>(std::max(16L, span));
+}
+
+// span that gives numTasks tasks over N elements, rounded like
+// chooseTaskSpan
+static inline int spanForTasks(int N, int numTasks)
+{
+    long span = (N + numTasks - 1) / numTasks;
+    span = (span + 15) / 16 * 16;
+    return static_cast<int>(std::max(16L, span));
+}
+
+#endif
@@ -0,0 +1,430 @@
+/*
+  This file implements the three entrypoints used by ispc-generated code
+  to handle 'launch' and 'sync' statements (ISPCLaunch, ISPCAlloc and
+  ISPCSync) on top of a persistent C++11 thread pool.  It is a drop-in
+  alternative to tasksys.cpp: link exactly one of the two into a program
+  (the asst1 Makefiles pick this one with "make TASKSYS=pool").
+
+  Each ISPCLaunch() becomes a single "launch record" holding the task
+  function, its argument block and an atomic cursor over [0, count).
+  Workers claim chunks of task indices from the cursor with one
+  fetch_add, so launching N tasks costs one queue insertion and one
+  wakeup rather than N of each, and dequeueing is contention-free once a
+  worker holds a record.  A thread blocked in ISPCSync() helps run the
+  tasks of its own group, so ispc functions that launch and sync from
+  inside a task never leave the pool without a thread making progress.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Signature of ispc-generated 'task' functions
+typedef void (*TaskFuncType)(void *data, int threadIndex, int threadCount,
+                             int taskIndex, int taskCount);
+
+class TaskGroup;
+
+// All of the tasks created by a single ISPCLaunch() call
+struct LaunchRecord {
+    TaskFuncType func;
+    void *data;
+    int taskCount;
+    int chunkSize;
+    std::atomic<int> nextTask;
+    TaskGroup *group;
+};
+
+///////////////////////////////////////////////////////////////////////////
+// TaskGroup
+
+/** A task group is the set of tasks launched from within a single ispc
+    function, along with the memory handed out by ISPCAlloc() for their
+    arguments.  The group is recycled through a free list once the
+    function that launched it has synced.
+ */
+class TaskGroup {
+public:
+    TaskGroup();
+    ~TaskGroup();
+
+    void Reset();
+
+    LaunchRecord *AllocLaunch();
+    void *AllocMemory(int64_t size, int32_t alignment);
+
+    void Launch(LaunchRecord *rec);
+    void Sync();
+
+    // Number of launched tasks that haven't finished running yet
+    std::atomic<int> numUnfinishedTasks;
+    // Number of threads currently holding a pointer to one of our records
+    std::atomic<int> numRecordRefs;
+
+private:
+    std::vector<LaunchRecord *> records;
+    int numRecords;
+
+    std::vector<char *> memBlocks;
+    int curMemBlock;
+    int64_t curMemOffset;
+    int64_t curMemSize;
+};
+
+
+#define MEM_BLOCK_SIZE (16 * 1024)
+
+///////////////////////////////////////////////////////////////////////////
+// Thread pool
+
+static int nThreads;
+static std::thread *threads = NULL;
+
+static std::mutex queueMutex;
+static std::condition_variable queueCond;
+static std::vector<LaunchRecord *> activeLaunches;
+static bool shuttingDown = false;
+
+static thread_local int lThreadIndex = 0;
+
+
+/* Grab a chunk of tasks from the record and run them; returns false once
+   the record's cursor has run past the end. */
+static bool
+lRunChunk(LaunchRecord *rec) {
+    int start = rec->nextTask.fetch_add(rec->chunkSize, std::memory_order_relaxed);
+    if (start >= rec->taskCount)
+        return false;
+
+    int end = std::min(start + rec->chunkSize, rec->taskCount);
+    for (int i = start; i < end; ++i)
+        rec->func(rec->data, lThreadIndex, nThreads + 1, i, rec->taskCount);
+
+    rec->group->numUnfinishedTasks.fetch_sub(end - start, std::memory_order_acq_rel);
+    return true;
+}
+
+
+/* Remove an exhausted record from the active list.  Must be called with
+   queueMutex held. */
+static void
+lRetireLaunch(LaunchRecord *rec) {
+    std::vector<LaunchRecord *>::iterator it =
+        std::find(activeLaunches.begin(), activeLaunches.end(), rec);
+    if (it != activeLaunches.end())
+        activeLaunches.erase(it);
+}
+
+
+static void
+lWorkerEntry(int threadIndex) {
+    lThreadIndex = threadIndex;
+
+    while (true) {
+        LaunchRecord *rec;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCond.wait(lock, [] {
+                return shuttingDown || !activeLaunches.empty();
+            });
+            if (shuttingDown)
+                return;
+
+            // Take the most recently launched work first; it is the most
+            // likely to still be in cache and, for nested launches, the
+            // one some other task is blocked on.
+            rec = activeLaunches.back();
+            rec->group->numRecordRefs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        while (lRunChunk(rec))
+            ;
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            lRetireLaunch(rec);
+        }
+        rec->group->numRecordRefs.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+
+static void
+lShutdownTaskSystem() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        shuttingDown = true;
+    }
+    queueCond.notify_all();
+    for (int i = 0; i < nThreads; ++i)
+        threads[i].join();
+    delete[] threads;
+    threads = NULL;
+}
+
+
+static std::atomic<bool> initialized(false);
+
+static void
+lInitTaskSystem() {
+    static std::once_flag initFlag;
+    std::call_once(initFlag, [] {
+        // We launch one fewer thread than there are cores, since the
+        // thread that syncs also runs tasks while it waits.
+        nThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        activeLaunches.reserve(64);
+
+        threads = new std::thread[nThreads];
+        for (int i = 0; i < nThreads; ++i)
+            threads[i] = std::thread(lWorkerEntry, i + 1);
+
+        atexit(lShutdownTaskSystem);
+        initialized.store(true, std::memory_order_release);
+    });
+}
+
+
+static inline void
+InitTaskSystem() {
+    if (!initialized.load(std::memory_order_acquire))
+        lInitTaskSystem();
+}
+
+///////////////////////////////////////////////////////////////////////////
+// TaskGroup implementation
+
+TaskGroup::TaskGroup() {
+    numUnfinishedTasks = 0;
+    numRecordRefs = 0;
+    numRecords = 0;
+    curMemBlock = -1;
+    curMemOffset = 0;
+    curMemSize = 0;
+}
+
+
+TaskGroup::~TaskGroup() {
+    for (size_t i = 0; i < records.size(); ++i)
+        delete records[i];
+    for (size_t i = 0; i < memBlocks.size(); ++i)
+        free(memBlocks[i]);
+}
+
+
+void
+TaskGroup::Reset() {
+    numRecords = 0;
+    curMemBlock = -1;
+    curMemOffset = 0;
+    curMemSize = 0;
+}
+
+
+LaunchRecord *
+TaskGroup::AllocLaunch() {
+    if (numRecords == (int)records.size())
+        records.push_back(new LaunchRecord);
+    return records[numRecords++];
+}
+
+
+void *
+TaskGroup::AllocMemory(int64_t size, int32_t alignment) {
+    if (curMemBlock >= 0) {
+        char *basePtr = memBlocks[curMemBlock];
+        intptr_t iptr = (intptr_t)(basePtr + curMemOffset);
+        iptr = (iptr + (alignment - 1)) & ~(intptr_t)(alignment - 1);
+        int64_t offset = (int64_t)(iptr - (intptr_t)basePtr);
+        if (offset + size <= curMemSize) {
+            curMemOffset = offset + size;
+            return (char *)iptr;
+        }
+    }
+
+    // Move on to the next block, replacing it if it's too small for this
+    // request.  Blocks are kept across Reset() so steady-state launches
+    // don't touch the heap.
+    ++curMemBlock;
+    int64_t needed = std::max((int64_t)MEM_BLOCK_SIZE, size + alignment);
+    if (curMemBlock == (int)memBlocks.size())
+        memBlocks.push_back(NULL);
+    if (memBlocks[curMemBlock] == NULL || needed > MEM_BLOCK_SIZE) {
+        free(memBlocks[curMemBlock]);
+        memBlocks[curMemBlock] = (char *)malloc(needed);
+        if (memBlocks[curMemBlock] == NULL) {
+            fprintf(stderr, "Out of memory allocating %lld bytes of task memory\n",
+                    (long long)needed);
+            exit(1);
+        }
+    }
+    curMemSize = needed;
+    curMemOffset = 0;
+    return AllocMemory(size, alignment);
+}
+
+
+void
+TaskGroup::Launch(LaunchRecord *rec) {
+    numUnfinishedTasks.fetch_add(rec->taskCount, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        activeLaunches.push_back(rec);
+    }
+    if (rec->taskCount == 1)
+        queueCond.notify_one();
+    else
+        queueCond.notify_all();
+}
+
+
+void
+TaskGroup::Sync() {
+    // Help out with our own tasks until every one of them has been
+    // claimed, then wait for the stragglers other threads are running.
+    for (int i = 0; i < numRecords; ++i)
+        while (lRunChunk(records[i]))
+            ;
+    while (numUnfinishedTasks.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+
+    // Workers may not have noticed our records are exhausted yet; pull
+    // them off the active list ourselves and wait for anyone still
+    // holding a pointer to one before the group is recycled.
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (int i = 0; i < numRecords; ++i)
+            lRetireLaunch(records[i]);
+    }
+    while (numRecordRefs.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+/* As in tasksys.cpp, each thread keeps a few recycled groups of its own
+   (a group is always freed by the thread that allocated it) in front of
+   the shared free list. */
+#define TASK_GROUP_CACHE_SIZE 4
+
+static std::mutex freeListMutex;
+static std::vector<TaskGroup *> freeTaskGroups;
+
+struct TaskGroupCache {
+    int count;
+    TaskGroup *groups[TASK_GROUP_CACHE_SIZE];
+
+    ~TaskGroupCache() {
+        std::lock_guard<std::mutex> lock(freeListMutex);
+        while (count > 0)
+            freeTaskGroups.push_back(groups[--count]);
+    }
+};
+
+static thread_local TaskGroupCache lTaskGroupCache;
+
+
+static inline TaskGroup *
+AllocTaskGroup() {
+    TaskGroupCache &cache = lTaskGroupCache;
+    if (cache.count > 0)
+        return cache.groups[--cache.count];
+
+    {
+        std::lock_guard<std::mutex> lock(freeListMutex);
+        if (!freeTaskGroups.empty()) {
+            TaskGroup *tg = freeTaskGroups.back();
+            freeTaskGroups.pop_back();
+            return tg;
+        }
+    }
+    return new TaskGroup;
+}
+
+
+static inline void
+FreeTaskGroup(TaskGroup *tg) {
+    tg->Reset();
+
+    TaskGroupCache &cache = lTaskGroupCache;
+    if (cache.count < TASK_GROUP_CACHE_SIZE) {
+        cache.groups[cache.count++] = tg;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(freeListMutex);
+    freeTaskGroups.push_back(tg);
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// ispc expects these functions to have C linkage / not be mangled
+extern "C" {
+    void ISPCLaunch(void **handlePtr, void *f, void *data, int count);
+    void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
+    void ISPCSync(void *handle);
+    void ISPCInitTaskSystem();
+}
+
+/* Not called by ispc-generated code: programs can call this once at
+   startup so that creating the worker threads doesn't land in the first
+   (timed) launch.  Launching without calling it still works. */
+void
+ISPCInitTaskSystem() {
+    InitTaskSystem();
+}
+
+
+void
+ISPCLaunch(void **taskGroupPtr, void *func, void *data, int count) {
+    TaskGroup *taskGroup;
+    if (*taskGroupPtr == NULL) {
+        InitTaskSystem();
+        taskGroup = AllocTaskGroup();
+        *taskGroupPtr = taskGroup;
+    }
+    else
+        taskGroup = (TaskGroup *)(*taskGroupPtr);
+
+    // Aim for several chunks per thread so that uneven tasks still
+    // balance, without paying an atomic per task for large launches.
+    LaunchRecord *rec = taskGroup->AllocLaunch();
+    rec->func = (TaskFuncType)func;
+    rec->data = data;
+    rec->taskCount = count;
+    rec->chunkSize = std::max(1, count / (8 * (nThreads + 1)));
+    rec->nextTask.store(0, std::memory_order_relaxed);
+    rec->group = taskGroup;
+    taskGroup->Launch(rec);
+}
+
+
+void
+ISPCSync(void *h) {
+    TaskGroup *taskGroup = (TaskGroup *)h;
+    if (taskGroup != NULL) {
+        taskGroup->Sync();
+        FreeTaskGroup(taskGroup);
+    }
+}
+
+
+void *
+ISPCAlloc(void **taskGroupPtr, int64_t size, int32_t alignment) {
+    TaskGroup *taskGroup;
+    if (*taskGroupPtr == NULL) {
+        InitTaskSystem();
+        taskGroup = AllocTaskGroup();
+        *taskGroupPtr = taskGroup;
+    }
+    else
+        taskGroup = (TaskGroup *)(*taskGroupPtr);
+
+    return taskGroup->AllocMemory(size, alignment);
+}
@@ -1,22 +1,11 @@
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
+#include <vector>
 #include <getopt.h>
 
 #include "CycleTimer.h"
-
-extern void mandelbrotSerial(
-    float x0, float y0, float x1, float y1,
-    int width, int height,
-    int startRow, int numRows,
-    int maxIterations,
-    int output[]);
-
-extern void mandelbrotThread(
-    int numThreads,
-    float x0, float y0, float x1, float y1,
-    int width, int height,
-    int maxIterations,
-    int output[]);
+#include "mandelbrotThread.h"
 
 extern void writePPMImage(
     int* data,
@@ -45,6 +34,14 @@ void usage(const char* progname) {
     printf("Usage: %s [options]\n", progname);
     printf("Program Options:\n");
     printf("  -t  --threads <N>  Use N threads\n");
+    printf("  -s  --schedule <S> Split rows by S = block, interleave or dynamic (default)\n");
+    printf("  -c  --chunk <N>    Rows handed out at a time by interleave/dynamic\n");
+    printf("                     (default 1, or 64 for the subdivide kernel)\n");
+    printf("  -k  --kernel <K>   Kernel for the threaded version: serial (default),\n");
+    printf("                     simd, pruned or subdivide.  subdivide is approximate:\n");
+    printf("                     its wrong pixels are counted, not checked; pruned is\n");
+    printf("                     the exact kernel that skips work inside the set\n");
+    printf("  -r  --scale <N>    Render at N times the default 1600x1200 resolution\n");
     printf("  -v  --view <INT>   Use specified view settings\n");
     printf("  -?  --help         This message\n");
 }
@@ -66,12 +63,28 @@ bool verifyResult (int *gold, int *result, int width, int height) {
     return 1;
 }
 
+long countMismatches (int *gold, int *result, int width, int height) {
+
+    long count = 0;
+
+    for (long i = 0; i < (long)width * height; i++) {
+        if (gold[i] != result[i])
+            count++;
+    }
+
+    return count;
+}
+
 int main(int argc, char** argv) {
 
-    const unsigned int width = 1600;
-    const unsigned int height = 1200;
+    unsigned int width = 1600;
+    unsigned int height = 1200;
     const int maxIterations = 256;
     int numThreads = 2;
+    ScheduleMode schedule = SCHEDULE_DYNAMIC;
+    int chunkRows = 0;
+    MandelbrotKernel kernel = mandelbrotSerial;
+    const char* kernelName = "serial";
 
     float x0 = -2;
     float x1 = 1;
@@ -82,17 +95,76 @@ int main(int argc, char** argv) {
     int opt;
     static struct option long_options[] = {
         {"threads", 1, 0, 't'},
+        {"schedule", 1, 0, 's'},
+        {"chunk", 1, 0, 'c'},
+        {"kernel", 1, 0, 'k'},
+        {"scale", 1, 0, 'r'},
         {"view", 1, 0, 'v'},
         {"help", 0, 0, '?'},
         {0 ,0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "t:v:?", long_options, NULL)) != EOF) {
+    while ((opt = getopt_long(argc, argv, "t:s:c:k:r:v:?", long_options, NULL)) != EOF) {
 
         switch (opt) {
         case 't':
         {
             numThreads = atoi(optarg);
+            if (numThreads < 1) {
+                fprintf(stderr, "Invalid thread count\n");
+                return 1;
+            }
+            break;
+        }
+        case 's':
+        {
+            if (strcmp(optarg, "block") == 0) {
+                schedule = SCHEDULE_BLOCKED;
+            } else if (strcmp(optarg, "interleave") == 0) {
+                schedule = SCHEDULE_INTERLEAVED;
+            } else if (strcmp(optarg, "dynamic") == 0) {
+                schedule = SCHEDULE_DYNAMIC;
+            } else {
+                fprintf(stderr, "Invalid schedule\n");
+                return 1;
+            }
+            break;
+        }
+        case 'c':
+        {
+            chunkRows = atoi(optarg);
+            if (chunkRows < 1) {
+                fprintf(stderr, "Invalid chunk size\n");
+                return 1;
+            }
+            break;
+        }
+        case 'k':
+        {
+            if (strcmp(optarg, "serial") == 0) {
+                kernel = mandelbrotSerial;
+            } else if (strcmp(optarg, "simd") == 0) {
+                kernel = mandelbrotSimd;
+            } else if (strcmp(optarg, "pruned") == 0) {
+                kernel = mandelbrotSerialPruned;
+            } else if (strcmp(optarg, "subdivide") == 0) {
+                kernel = mandelbrotSubdivide;
+            } else {
+                fprintf(stderr, "Invalid kernel\n");
+                return 1;
+            }
+            kernelName = optarg;
+            break;
+        }
+        case 'r':
+        {
+            int scale = atoi(optarg);
+            if (scale < 1) {
+                fprintf(stderr, "Invalid scale\n");
+                return 1;
+            }
+            width *= scale;
+            height *= scale;
             break;
         }
         case 'v':
@@ -118,6 +190,10 @@ int main(int argc, char** argv) {
     }
     // end parsing of commandline options
 
+    // subdivision only pays off on bands of many rows
+    if (chunkRows == 0)
+        chunkRows = (kernel == mandelbrotSubdivide) ? 64 : 1;
+
 
     int* output_serial = new int[width*height];
     int* output_thread = new int[width*height];
@@ -139,23 +215,92 @@ int main(int argc, char** argv) {
     printf("[mandelbrot serial]:\t\t[%.3f] ms\n", minSerial * 1000);
     writePPMImage(output_serial, width, height, "mandelbrot-serial.ppm", maxIterations);
 
+    //
+    // Run the vectorized kernel on one thread
+    //
+
+    double minSimd = 1e30;
+    for (int i = 0; i < 5; ++i) {
+       memset(output_thread, 0, width * height * sizeof(int));
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrotSimd(x0, y0, x1, y1, width, height, 0, height, maxIterations, output_thread);
+        double endTime = CycleTimer::currentSeconds();
+        minSimd = std::min(minSimd, endTime - startTime);
+    }
+
+    printf("[mandelbrot simd %s]:\t[%.3f] ms\n", mandelbrotSimdISA(), minSimd * 1000);
+
+    if (! verifyResult (output_serial, output_thread, width, height)) {
+        printf ("Error : Output from simd kernel does not match serial output\n");
+
+        delete[] output_serial;
+        delete[] output_thread;
+
+        return 1;
+    }
+
+    printf("\t\t\t\t(%.2fx speedup from simd)\n", minSerial/minSimd);
+
+    //
+    // Run the serial kernel with interior and cycle rejection
+    //
+
+    double minPruned = 1e30;
+    for (int i = 0; i < 5; ++i) {
+       memset(output_thread, 0, width * height * sizeof(int));
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrotSerialPruned(x0, y0, x1, y1, width, height, 0, height, maxIterations, output_thread);
+        double endTime = CycleTimer::currentSeconds();
+        minPruned = std::min(minPruned, endTime - startTime);
+    }
+
+    printf("[mandelbrot serial pruned]:\t[%.3f] ms\n", minPruned * 1000);
+
+    if (! verifyResult (output_serial, output_thread, width, height)) {
+        printf ("Error : Output from pruned kernel does not match serial output\n");
+
+        delete[] output_serial;
+        delete[] output_thread;
+
+        return 1;
+    }
+
+    printf("\t\t\t\t(%.2fx speedup from pruning)\n", minSerial/minPruned);
+
     //
     // Run the threaded version
     //
 
+    // per-thread busy time of the fastest run
+    std::vector<double> busyTime(numThreads);
+    std::vector<double> runBusyTime(numThreads);
+
     double minThread = 1e30;
     for (int i = 0; i < 5; ++i) {
       memset(output_thread, 0, width * height * sizeof(int));
         double startTime = CycleTimer::currentSeconds();
-        mandelbrotThread(numThreads, x0, y0, x1, y1, width, height, maxIterations, output_thread);
+        mandelbrotThread(numThreads, kernel, schedule, chunkRows, x0, y0, x1, y1, width, height, maxIterations, output_thread, runBusyTime.data());
         double endTime = CycleTimer::currentSeconds();
-        minThread = std::min(minThread, endTime - startTime);
+        if (endTime - startTime < minThread) {
+            minThread = endTime - startTime;
+            busyTime = runBusyTime;
+        }
     }
 
     printf("[mandelbrot thread]:\t\t[%.3f] ms\n", minThread * 1000);
+    for (int i = 0; i < numThreads; ++i) {
+        printf("\t[thread %2d busy]:\t[%.3f] ms\n", i, busyTime[i] * 1000);
+    }
     writePPMImage(output_thread, width, height, "mandelbrot-thread.ppm", maxIterations);
 
-    if (! verifyResult (output_serial, output_thread, width, height)) {
+    // Subdivision fills rectangles without computing them and is not
+    // checked against the serial output; report how far off it is.  Every
+    // other kernel must match.
+    if (kernel == mandelbrotSubdivide) {
+        long mismatches = countMismatches(output_serial, output_thread, width, height);
+        printf("\t\t\t\t(approximate: %ld of %u pixels differ from brute force)\n",
+               mismatches, width * height);
+    } else if (! verifyResult (output_serial, output_thread, width, height)) {
         printf ("Error : Output from threads does not match serial output\n");
 
         delete[] output_serial;
@@ -165,7 +310,8 @@ int main(int argc, char** argv) {
     }
 
     // compute speedup
-    printf("\t\t\t\t(%.2fx speedup from %d threads)\n", minSerial/minThread, numThreads);
+    printf("\t\t\t\t(%.2fx speedup from %d threads, %s kernel)\n", minSerial/minThread, numThreads,
+           kernelName);
 
     delete[] output_serial;
     delete[] output_thread;
@@ -56,6 +56,59 @@ static inline int mandel(float c_re, float c_im, int count)
     return i;
 }
 
+//
+// Cheaper mandel() for points that never escape, returning exactly the
+// same counts:
+//
+// * points inside the main cardioid or the period-2 bulb are known to be
+//   in the set and return count without iterating.
+// * otherwise z is compared against a value saved at doubling intervals
+//   (Brent's method).  The float iteration is deterministic, so once z
+//   repeats bit for bit the orbit is periodic, can never escape, and the
+//   loop would have run to count anyway.
+//
+static inline bool inCardioidOrBulb(float c_re, float c_im)
+{
+    float c_im2 = c_im * c_im;
+    float x = c_re - 0.25f;
+    float q = x * x + c_im2;
+    if (q * (q + x) <= 0.25f * c_im2)
+        return true;
+    return (c_re + 1.f) * (c_re + 1.f) + c_im2 <= 0.0625f;
+}
+
+static inline int mandelPruned(float c_re, float c_im, int count)
+{
+    if (inCardioidOrBulb(c_re, c_im))
+        return count;
+
+    float z_re = c_re, z_im = c_im;
+    float old_re = z_re, old_im = z_im;
+    int period = 0, checkInterval = 8;
+    int i;
+    for (i = 0; i < count; ++i) {
+
+        if (z_re * z_re + z_im * z_im > 4.f)
+            break;
+
+        float new_re = z_re*z_re - z_im*z_im;
+        float new_im = 2.f * z_re * z_im;
+        z_re = c_re + new_re;
+        z_im = c_im + new_im;
+
+        if (z_re == old_re && z_im == old_im)
+            return count;
+        if (++period == checkInterval) {
+            period = 0;
+            checkInterval *= 2;
+            old_re = z_re;
+            old_im = z_im;
+        }
+    }
+
+    return i;
+}
+
 //
 // MandelbrotSerial --
 //
@@ -90,3 +143,153 @@ void mandelbrotSerial(
     }
 }
 
+//
+// MandelbrotSerialPruned --
+//
+// mandelbrotSerial with interior and cycle rejection (see mandelPruned);
+// the output is identical.
+void mandelbrotSerialPruned(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int totalRows,
+    int maxIterations,
+    int output[])
+{
+    float dx = (x1 - x0) / width;
+    float dy = (y1 - y0) / height;
+
+    int endRow = startRow + totalRows;
+
+    for (int j = startRow; j < endRow; j++) {
+        for (int i = 0; i < width; ++i) {
+            float x = x0 + i * dx;
+            float y = y0 + j * dy;
+
+            int index = (j * width + i);
+            output[index] = mandelPruned(x, y, maxIterations);
+        }
+    }
+}
+
+
+//
+// Mariani-Silver subdivision.  Escape-count regions are connected, so
+// if every pixel on the border of a rectangle has the same count, the
+// pixels inside are assumed to have it too and are filled without
+// iterating.  Otherwise the rectangle is split in two along its longer
+// side, the new dividing line is computed, and both halves are handled
+// the same way.  Small rectangles are computed pixel by pixel.
+//
+// Sampling on a pixel grid can miss features thinner than a pixel, and
+// float orbits near the set's boundary do not always behave like their
+// neighbours, so the filled result may differ from mandelbrotSerial in a
+// handful of pixels (tens per million at 1600x1200).  An exact image only
+// gets the cardioid/bulb shortcut of mandelbrotSerialPruned: filling just
+// the pixels that test proves are in the set leaves subdivision nothing
+// to save over it.
+//
+
+// rectangles with at most this many interior pixels are computed directly
+static const int MIN_SUBDIVIDE_AREA = 16;
+
+struct SubdivideImage {
+    float x0, y0;
+    float dx, dy;
+    int width;
+    int maxIterations;
+    int* output;
+};
+
+static inline void subdividePixel(const SubdivideImage& img, int i, int j)
+{
+    float x = img.x0 + i * img.dx;
+    float y = img.y0 + j * img.dy;
+    img.output[j * img.width + i] = mandel(x, y, img.maxIterations);
+}
+
+// The border of the rectangle [i0, i1] x [j0, j1] (inclusive) has
+// already been computed; fills in its interior.
+static void subdivideRect(const SubdivideImage& img, int i0, int j0, int i1, int j1)
+{
+    if (i1 - i0 < 2 || j1 - j0 < 2)
+        return;
+
+    int* output = img.output;
+    int width = img.width;
+
+    int count = output[j0 * width + i0];
+    bool uniform = true;
+    for (int i = i0; i <= i1 && uniform; i++)
+        uniform = output[j0 * width + i] == count && output[j1 * width + i] == count;
+    for (int j = j0 + 1; j < j1 && uniform; j++)
+        uniform = output[j * width + i0] == count && output[j * width + i1] == count;
+
+    if (uniform) {
+        for (int j = j0 + 1; j < j1; j++)
+            for (int i = i0 + 1; i < i1; i++)
+                output[j * width + i] = count;
+        return;
+    }
+
+    if ((i1 - i0 - 1) * (j1 - j0 - 1) <= MIN_SUBDIVIDE_AREA) {
+        for (int j = j0 + 1; j < j1; j++)
+            for (int i = i0 + 1; i < i1; i++)
+                subdividePixel(img, i, j);
+        return;
+    }
+
+    if (i1 - i0 >= j1 - j0) {
+        int im = (i0 + i1) / 2;
+        for (int j = j0 + 1; j < j1; j++)
+            subdividePixel(img, im, j);
+        subdivideRect(img, i0, j0, im, j1);
+        subdivideRect(img, im, j0, i1, j1);
+    } else {
+        int jm = (j0 + j1) / 2;
+        for (int i = i0 + 1; i < i1; i++)
+            subdividePixel(img, i, jm);
+        subdivideRect(img, i0, j0, i1, jm);
+        subdivideRect(img, i0, jm, i1, j1);
+    }
+}
+
+//
+// MandelbrotSubdivide --
+//
+// Computes rows [startRow, startRow + totalRows) by subdividing them as
+// one rectangle.  Has the same interface as mandelbrotSerial, so the
+// thread harness can hand it bands of rows.
+void mandelbrotSubdivide(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int totalRows,
+    int maxIterations,
+    int output[])
+{
+    if (totalRows <= 0)
+        return;
+
+    SubdivideImage img;
+    img.x0 = x0;
+    img.y0 = y0;
+    img.dx = (x1 - x0) / width;
+    img.dy = (y1 - y0) / height;
+    img.width = width;
+    img.maxIterations = maxIterations;
+    img.output = output;
+
+    int endRow = startRow + totalRows - 1;
+
+    for (int i = 0; i < width; i++) {
+        subdividePixel(img, i, startRow);
+        if (endRow != startRow)
+            subdividePixel(img, i, endRow);
+    }
+    for (int j = startRow + 1; j < endRow; j++) {
+        subdividePixel(img, 0, j);
+        if (width > 1)
+            subdividePixel(img, width - 1, j);
+    }
+
+    subdivideRect(img, 0, startRow, width - 1, endRow);
+}
@@ -1,7 +1,11 @@
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
 #include <thread>
+#include <vector>
 
 #include "CycleTimer.h"
+#include "mandelbrotThread.h"
 
 typedef struct {
     float x0, x1;
@@ -12,16 +16,20 @@ typedef struct {
     int* output;
     int threadId;
     int numThreads;
+    MandelbrotKernel kernel;
+    ScheduleMode schedule;
+    int chunkRows;
+    std::atomic<int>* nextRow;
+    double busyTime;
 } WorkerArgs;
 
 
-extern void mandelbrotSerial(
-    float x0, float y0, float x1, float y1,
-    int width, int height,
-    int startRow, int numRows,
-    int maxIterations,
-    int output[]);
-
+static void computeRows(WorkerArgs * const args, int startRow, int numRows) {
+    numRows = std::min(numRows, (int)args->height - startRow);
+    args->kernel(args->x0, args->y0, args->x1, args->y1,
+        args->width, args->height, startRow, numRows,
+        args->maxIterations, args->output);
+}
 
 //
 // workerThreadStart --
@@ -29,23 +37,44 @@ extern void mandelbrotSerial(
 // Thread entrypoint.
 void workerThreadStart(WorkerArgs * const args) {
 
-    // TODO FOR CS149 STUDENTS: Implement the body of the worker
-    // thread here. Each thread should make a call to mandelbrotSerial()
-    // to compute a part of the output image.  For example, in a
-    // program that uses two threads, thread 0 could compute the top
-    // half of the image and thread 1 could compute the bottom half.
-    // if (args->threadId != 0) {
-    //     return;
-    // }
-    int rows_per_thread = args->height / args->numThreads;
-    int start_rows = args->threadId * rows_per_thread;
-    if (args->threadId == args->numThreads - 1) {
-        rows_per_thread += args->height % args->numThreads;
+    double startTime = CycleTimer::currentSeconds();
+
+    switch (args->schedule) {
+    case SCHEDULE_BLOCKED:
+    {
+        // The part of the image containing the set's interior costs far
+        // more per row than the rest, so with this split the thread that
+        // owns it determines the running time.
+        int rows_per_thread = args->height / args->numThreads;
+        int start_rows = args->threadId * rows_per_thread;
+        if (args->threadId == args->numThreads - 1) {
+            rows_per_thread += args->height % args->numThreads;
+        }
+        computeRows(args, start_rows, rows_per_thread);
+        break;
     }
-    mandelbrotSerial(args->x0, args->y0, args->x1, args->y1, 
-        args->width, args->height, start_rows, rows_per_thread, 
-        args->maxIterations, args->output);
-    printf("Hello world from thread %d\n", args->threadId);
+    case SCHEDULE_INTERLEAVED:
+    {
+        int stride = args->numThreads * args->chunkRows;
+        for (int row = args->threadId * args->chunkRows; row < (int)args->height; row += stride) {
+            computeRows(args, row, args->chunkRows);
+        }
+        break;
+    }
+    case SCHEDULE_DYNAMIC:
+    {
+        while (true) {
+            int row = args->nextRow->fetch_add(args->chunkRows, std::memory_order_relaxed);
+            if (row >= (int)args->height) {
+                break;
+            }
+            computeRows(args, row, args->chunkRows);
+        }
+        break;
+    }
+    }
+
+    args->busyTime = CycleTimer::currentSeconds() - startTime;
 }
 
 //
@@ -55,27 +84,19 @@ void workerThreadStart(WorkerArgs * const args) {
 // Threads of execution are created by spawning std::threads.
 void mandelbrotThread(
     int numThreads,
+    MandelbrotKernel kernel,
+    ScheduleMode schedule, int chunkRows,
     float x0, float y0, float x1, float y1,
     int width, int height,
-    int maxIterations, int output[])
+    int maxIterations, int output[],
+    double busyTime[])
 {
-    static constexpr int MAX_THREADS = 32;
-
-    if (numThreads > MAX_THREADS)
-    {
-        fprintf(stderr, "Error: Max allowed threads is %d\n", MAX_THREADS);
-        exit(1);
-    }
-
     // Creates thread objects that do not yet represent a thread.
-    std::thread workers[MAX_THREADS];
-    WorkerArgs args[MAX_THREADS];
+    std::vector<std::thread> workers(numThreads);
+    std::vector<WorkerArgs> args(numThreads);
+    std::atomic<int> nextRow(0);
 
     for (int i=0; i<numThreads; i++) {
-      
-        // TODO FOR CS149 STUDENTS: You may or may not wish to modify
-        // the per-thread arguments here.  The code below copies the
-        // same arguments for each thread
         args[i].x0 = x0;
         args[i].y0 = y0;
         args[i].x1 = x1;
@@ -85,7 +106,12 @@ void mandelbrotThread(
         args[i].maxIterations = maxIterations;
         args[i].numThreads = numThreads;
         args[i].output = output;
-      
+        args[i].kernel = kernel;
+        args[i].schedule = schedule;
+        args[i].chunkRows = chunkRows;
+        args[i].nextRow = &nextRow;
+        args[i].busyTime = 0.0;
+
         args[i].threadId = i;
     }
 
@@ -95,12 +121,18 @@ void mandelbrotThread(
     for (int i=1; i<numThreads; i++) {
         workers[i] = std::thread(workerThreadStart, &args[i]);
     }
-    
+
     workerThreadStart(&args[0]);
 
     // join worker threads
     for (int i=1; i<numThreads; i++) {
         workers[i].join();
     }
+
+    if (busyTime) {
+        for (int i=0; i<numThreads; i++) {
+            busyTime[i] = args[i].busyTime;
+        }
+    }
 }
 
@@ -0,0 +1,79 @@
+#ifndef _MANDELBROT_THREAD_H
+#define _MANDELBROT_THREAD_H
+
+//
+// How mandelbrotThread() splits the rows of the image between threads:
+//
+// * SCHEDULE_BLOCKED: thread i gets the i'th contiguous block of
+//   height / numThreads rows.
+// * SCHEDULE_INTERLEAVED: rows are dealt out in chunks of chunkRows,
+//   round robin, so every thread sees every part of the image.
+// * SCHEDULE_DYNAMIC: threads repeatedly grab the next chunkRows rows
+//   from a shared atomic cursor until the image is done.
+//
+enum ScheduleMode {
+    SCHEDULE_BLOCKED,
+    SCHEDULE_INTERLEAVED,
+    SCHEDULE_DYNAMIC,
+};
+
+// Computes rows [startRow, startRow + numRows) of the image;
+// all the kernels below have this signature.
+typedef void (*MandelbrotKernel)(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
+void mandelbrotSerial(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
+// mandelbrotSerial that skips points in the main cardioid and period-2
+// bulb and stops orbits once they cycle; produces identical output.
+void mandelbrotSerialPruned(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
+// Mariani-Silver subdivision of the given rows: rectangles with a uniform
+// border are filled without iterating.  Approximate: may differ from
+// mandelbrotSerial in a few pixels (mandelbrotSerialPruned is exact).
+void mandelbrotSubdivide(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
+// Vectorized mandelbrotSerial (AVX-512 or AVX2, picked at runtime);
+// produces bit-identical output.
+void mandelbrotSimd(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
+// "avx512", "avx2" or "scalar"
+const char* mandelbrotSimdISA();
+
+// busyTime, if not NULL, receives the seconds each thread spent
+// computing (numThreads entries).
+void mandelbrotThread(
+    int numThreads,
+    MandelbrotKernel kernel,
+    ScheduleMode schedule, int chunkRows,
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int maxIterations,
+    int output[],
+    double busyTime[]);
+
+#endif
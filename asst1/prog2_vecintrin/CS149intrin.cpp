@@ -1,261 +1,393 @@
 #include "CS149intrin.h"
 #include "logger.h"
 
+// the native backend is entirely inline in CS149intrin_native.h
+#ifndef CS149_NATIVE
+
 //******************
 //* Implementation *
 //******************
 
-__cs149_mask _cs149_init_ones(int first) {
-  __cs149_mask mask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+// Call site reported to the logger: the return address of the intrinsic
+// the user called.  The typed helpers are always inlined into their
+// _float/_int wrappers, so inside them it is still the user's call site.
+#define CALL_SITE __builtin_return_address(0)
+#define HELPER __attribute__((always_inline)) inline
+
+template <int W>
+__cs149_mask_w<W> _cs149_init_ones(int first) {
+  __cs149_mask_w<W> mask;
+  for (int i=0; i<W; i++) {
     mask.value[i] = (i<first) ? true : false;
   }
   return mask;
 }
 
-__cs149_mask _cs149_mask_not(__cs149_mask &maska) {
-  __cs149_mask resultMask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <int W>
+__cs149_mask_w<W> _cs149_mask_not(__cs149_mask_w<W> &maska) {
+  __cs149_mask_w<W> resultMask;
+  for (int i=0; i<W; i++) {
     resultMask.value[i] = !maska.value[i];
   }
-  CS149Logger.addLog("masknot", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("masknot", _cs149_init_ones<W>().value, W, CALL_SITE);
   return resultMask;
 }
 
-__cs149_mask _cs149_mask_or(__cs149_mask &maska, __cs149_mask &maskb) {
-  __cs149_mask resultMask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <int W>
+__cs149_mask_w<W> _cs149_mask_or(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb) {
+  __cs149_mask_w<W> resultMask;
+  for (int i=0; i<W; i++) {
     resultMask.value[i] = maska.value[i] | maskb.value[i];
   }
-  CS149Logger.addLog("maskor", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("maskor", _cs149_init_ones<W>().value, W, CALL_SITE);
   return resultMask;
 }
 
-__cs149_mask _cs149_mask_and(__cs149_mask &maska, __cs149_mask &maskb) {
-  __cs149_mask resultMask;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <int W>
+__cs149_mask_w<W> _cs149_mask_and(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb) {
+  __cs149_mask_w<W> resultMask;
+  for (int i=0; i<W; i++) {
     resultMask.value[i] = maska.value[i] && maskb.value[i];
   }
-  CS149Logger.addLog("maskand", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("maskand", _cs149_init_ones<W>().value, W, CALL_SITE);
   return resultMask;
 }
 
-int _cs149_cntbits(__cs149_mask &maska) {
+template <int W>
+int _cs149_cntbits(__cs149_mask_w<W> &maska) {
   int count = 0;
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+  for (int i=0; i<W; i++) {
     if (maska.value[i]) count++;
   }
-  CS149Logger.addLog("cntbits", _cs149_init_ones(), VECTOR_WIDTH);
+  CS149Logger.addLog("cntbits", _cs149_init_ones<W>().value, W, CALL_SITE);
   return count;
 }
 
-template <typename T>
-void _cs149_vset(__cs149_vec<T> &vecResult, T value, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vset(__cs149_vec<T, W> &vecResult, T value, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? value : vecResult.value[i];
   }
-  CS149Logger.addLog("vset", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vset", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vset<float>(__cs149_vec_float &vecResult, float value, __cs149_mask &mask);
-template void _cs149_vset<int>(__cs149_vec_int &vecResult, int value, __cs149_mask &mask);
-
-void _cs149_vset_float(__cs149_vec_float &vecResult, float value, __cs149_mask &mask) { _cs149_vset<float>(vecResult, value, mask); }
-void _cs149_vset_int(__cs149_vec_int &vecResult, int value, __cs149_mask &mask) { _cs149_vset<int>(vecResult, value, mask); }
+template <int W>
+void _cs149_vset_float(__cs149_vec<float, W> &vecResult, float value, __cs149_mask_w<W> &mask) { _cs149_vset<float, W>(vecResult, value, mask); }
+template <int W>
+void _cs149_vset_int(__cs149_vec<int, W> &vecResult, int value, __cs149_mask_w<W> &mask) { _cs149_vset<int, W>(vecResult, value, mask); }
 
-__cs149_vec_float _cs149_vset_float(float value) {
-  __cs149_vec_float vecResult;
-  __cs149_mask mask = _cs149_init_ones();
-  _cs149_vset_float(vecResult, value, mask);
+template <int W>
+__cs149_vec<float, W> _cs149_vset_float(float value) {
+  __cs149_vec<float, W> vecResult;
+  __cs149_mask_w<W> mask = _cs149_init_ones<W>();
+  _cs149_vset<float, W>(vecResult, value, mask);
   return vecResult;
 }
-__cs149_vec_int _cs149_vset_int(int value) {
-  __cs149_vec_int vecResult;
-  __cs149_mask mask = _cs149_init_ones();
-  _cs149_vset_int(vecResult, value, mask);
+template <int W>
+__cs149_vec<int, W> _cs149_vset_int(int value) {
+  __cs149_vec<int, W> vecResult;
+  __cs149_mask_w<W> mask = _cs149_init_ones<W>();
+  _cs149_vset<int, W>(vecResult, value, mask);
   return vecResult;
 }
 
-template <typename T>
-void _cs149_vmove(__cs149_vec<T> &dest, __cs149_vec<T> &src, __cs149_mask &mask) {
-    for (int i = 0; i < VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vmove(__cs149_vec<T, W> &dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+    for (int i = 0; i < W; i++) {
         dest.value[i] = mask.value[i] ? src.value[i] : dest.value[i];
     }
-    CS149Logger.addLog("vmove", mask, VECTOR_WIDTH);
+    CS149Logger.addLog("vmove", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vmove<float>(__cs149_vec_float &dest, __cs149_vec_float &src, __cs149_mask &mask);
-template void _cs149_vmove<int>(__cs149_vec_int &dest, __cs149_vec_int &src, __cs149_mask &mask);
+template <int W>
+void _cs149_vmove_float(__cs149_vec<float, W> &dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vmove<float, W>(dest, src, mask); }
+template <int W>
+void _cs149_vmove_int(__cs149_vec<int, W> &dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vmove<int, W>(dest, src, mask); }
 
-void _cs149_vmove_float(__cs149_vec_float &dest, __cs149_vec_float &src, __cs149_mask &mask) { _cs149_vmove<float>(dest, src, mask); }
-void _cs149_vmove_int(__cs149_vec_int &dest, __cs149_vec_int &src, __cs149_mask &mask) { _cs149_vmove<int>(dest, src, mask); }
-
-template <typename T>
-void _cs149_vload(__cs149_vec<T> &dest, T* src, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vload(__cs149_vec<T, W> &dest, T* src, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     dest.value[i] = mask.value[i] ? src[i] : dest.value[i];
   }
-  CS149Logger.addLog("vload", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vload", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vload<float>(__cs149_vec_float &dest, float* src, __cs149_mask &mask);
-template void _cs149_vload<int>(__cs149_vec_int &dest, int* src, __cs149_mask &mask);
-
-void _cs149_vload_float(__cs149_vec_float &dest, float* src, __cs149_mask &mask) { _cs149_vload<float>(dest, src, mask); }
-void _cs149_vload_int(__cs149_vec_int &dest, int* src, __cs149_mask &mask) { _cs149_vload<int>(dest, src, mask); }
+template <int W>
+void _cs149_vload_float(__cs149_vec<float, W> &dest, float* src, __cs149_mask_w<W> &mask) { _cs149_vload<float, W>(dest, src, mask); }
+template <int W>
+void _cs149_vload_int(__cs149_vec<int, W> &dest, int* src, __cs149_mask_w<W> &mask) { _cs149_vload<int, W>(dest, src, mask); }
 
-template <typename T>
-void _cs149_vstore(T* dest, __cs149_vec<T> &src, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vstore(T* dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     dest[i] = mask.value[i] ? src.value[i] : dest[i];
   }
-  CS149Logger.addLog("vstore", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vstore", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vstore<float>(float* dest, __cs149_vec_float &src, __cs149_mask &mask);
-template void _cs149_vstore<int>(int* dest, __cs149_vec_int &src, __cs149_mask &mask);
+template <int W>
+void _cs149_vstore_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vstore<float, W>(dest, src, mask); }
+template <int W>
+void _cs149_vstore_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vstore<int, W>(dest, src, mask); }
 
-void _cs149_vstore_float(float* dest, __cs149_vec_float &src, __cs149_mask &mask) { _cs149_vstore<float>(dest, src, mask); }
-void _cs149_vstore_int(int* dest, __cs149_vec_int &src, __cs149_mask &mask) { _cs149_vstore<int>(dest, src, mask); }
-
-template <typename T>
-void _cs149_vadd(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vadd(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] + vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vadd", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vadd", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vadd<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vadd<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vadd<float>(vecResult, veca, vecb, mask); }
-void _cs149_vadd_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vadd<int>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vadd<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vadd_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vadd<int, W>(vecResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vsub(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vsub(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] - vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vsub", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vsub", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vsub<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vsub<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vsub_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vsub<float>(vecResult, veca, vecb, mask); }
-void _cs149_vsub_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vsub<int>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vsub_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vsub<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vsub_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vsub<int, W>(vecResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vmult(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vmult(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] * vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vmult", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vmult", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vmult<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vmult<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vmult_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmult<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vmult_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmult<int, W>(vecResult, veca, vecb, mask); }
 
-void _cs149_vmult_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vmult<float>(vecResult, veca, vecb, mask); }
-void _cs149_vmult_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vmult<int>(vecResult, veca, vecb, mask); }
-
-template <typename T>
-void _cs149_vdiv(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vdiv(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (veca.value[i] / vecb.value[i]) : vecResult.value[i];
   }
-  CS149Logger.addLog("vdiv", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vdiv", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vdiv<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vdiv<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vdiv_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vdiv<float>(vecResult, veca, vecb, mask); }
-void _cs149_vdiv_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vdiv<int>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vdiv_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vdiv<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vdiv_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vdiv<int, W>(vecResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vabs(__cs149_vec<T> &vecResult, __cs149_vec<T> &veca, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vabs(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     vecResult.value[i] = mask.value[i] ? (abs(veca.value[i])) : vecResult.value[i];
   }
-  CS149Logger.addLog("vabs", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vabs", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vabs<float>(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_mask &mask);
-template void _cs149_vabs<int>(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_mask &mask);
+template <int W>
+void _cs149_vabs_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_mask_w<W> &mask) { _cs149_vabs<float, W>(vecResult, veca, mask); }
+template <int W>
+void _cs149_vabs_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_mask_w<W> &mask) { _cs149_vabs<int, W>(vecResult, veca, mask); }
 
-void _cs149_vabs_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_mask &mask) { _cs149_vabs<float>(vecResult, veca, mask); }
-void _cs149_vabs_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_mask &mask) { _cs149_vabs<int>(vecResult, veca, mask); }
-
-template <typename T>
-void _cs149_vgt(__cs149_mask &maskResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vgt(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     maskResult.value[i] = mask.value[i] ? (veca.value[i] > vecb.value[i]) : maskResult.value[i];
   }
-  CS149Logger.addLog("vgt", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vgt", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vgt<float>(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vgt<int>(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vgt_float(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vgt<float>(maskResult, veca, vecb, mask); }
-void _cs149_vgt_int(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vgt<int>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vgt_float(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vgt<float, W>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vgt_int(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vgt<int, W>(maskResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_vlt(__cs149_mask &maskResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_vlt(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     maskResult.value[i] = mask.value[i] ? (veca.value[i] < vecb.value[i]) : maskResult.value[i];
   }
-  CS149Logger.addLog("vlt", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("vlt", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_vlt<float>(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_vlt<int>(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
-
-void _cs149_vlt_float(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_vlt<float>(maskResult, veca, vecb, mask); }
-void _cs149_vlt_int(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_vlt<int>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vlt_float(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vlt<float, W>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vlt_int(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vlt<int, W>(maskResult, veca, vecb, mask); }
 
-template <typename T>
-void _cs149_veq(__cs149_mask &maskResult, __cs149_vec<T> &veca, __cs149_vec<T> &vecb, __cs149_mask &mask) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
+template <typename T, int W>
+HELPER void _cs149_veq(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
     maskResult.value[i] = mask.value[i] ? (veca.value[i] == vecb.value[i]) : maskResult.value[i];
   }
-  CS149Logger.addLog("veq", mask, VECTOR_WIDTH);
+  CS149Logger.addLog("veq", mask.value, W, CALL_SITE);
+}
+
+template <int W>
+void _cs149_veq_float(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_veq<float, W>(maskResult, veca, vecb, mask); }
+template <int W>
+void _cs149_veq_int(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_veq<int, W>(maskResult, veca, vecb, mask); }
+
+template <typename T, int W>
+HELPER void _cs149_vmin(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    vecResult.value[i] = mask.value[i] ? (veca.value[i] < vecb.value[i] ? veca.value[i] : vecb.value[i]) : vecResult.value[i];
+  }
+  CS149Logger.addLog("vmin", mask.value, W, CALL_SITE);
+}
+
+template <int W>
+void _cs149_vmin_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmin<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vmin_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmin<int, W>(vecResult, veca, vecb, mask); }
+
+template <typename T, int W>
+HELPER void _cs149_vmax(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    vecResult.value[i] = mask.value[i] ? (veca.value[i] > vecb.value[i] ? veca.value[i] : vecb.value[i]) : vecResult.value[i];
+  }
+  CS149Logger.addLog("vmax", mask.value, W, CALL_SITE);
+}
+
+template <int W>
+void _cs149_vmax_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmax<float, W>(vecResult, veca, vecb, mask); }
+template <int W>
+void _cs149_vmax_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { _cs149_vmax<int, W>(vecResult, veca, vecb, mask); }
+
+template <typename T, int W>
+HELPER void _cs149_vgather(__cs149_vec<T, W> &dest, T* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    dest.value[i] = mask.value[i] ? src[index.value[i]] : dest.value[i];
+  }
+  CS149Logger.addLog("vgather", mask.value, W, CALL_SITE);
 }
 
-template void _cs149_veq<float>(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-template void _cs149_veq<int>(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W>
+void _cs149_vgather_float(__cs149_vec<float, W> &dest, float* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vgather<float, W>(dest, src, index, mask); }
+template <int W>
+void _cs149_vgather_int(__cs149_vec<int, W> &dest, int* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vgather<int, W>(dest, src, index, mask); }
 
-void _cs149_veq_float(__cs149_mask &maskResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask) { _cs149_veq<float>(maskResult, veca, vecb, mask); }
-void _cs149_veq_int(__cs149_mask &maskResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask) { _cs149_veq<int>(maskResult, veca, vecb, mask); }
+template <typename T, int W>
+HELPER void _cs149_vscatter(T* dest, __cs149_vec<int, W> &index, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  for (int i=0; i<W; i++) {
+    if (mask.value[i]) dest[index.value[i]] = src.value[i];
+  }
+  CS149Logger.addLog("vscatter", mask.value, W, CALL_SITE);
+}
 
-template <typename T>
-void _cs149_hadd(__cs149_vec<T> &vecResult, __cs149_vec<T> &vec) {
-  for (int i=0; i<VECTOR_WIDTH/2; i++) {
+template <int W>
+void _cs149_vscatter_float(float* dest, __cs149_vec<int, W> &index, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vscatter<float, W>(dest, index, src, mask); }
+template <int W>
+void _cs149_vscatter_int(int* dest, __cs149_vec<int, W> &index, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vscatter<int, W>(dest, index, src, mask); }
+
+template <typename T, int W>
+HELPER int _cs149_vcompress(T* dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  int count = 0;
+  for (int i=0; i<W; i++) {
+    if (mask.value[i]) dest[count++] = src.value[i];
+  }
+  CS149Logger.addLog("vcompress", mask.value, W, CALL_SITE);
+  return count;
+}
+
+template <int W>
+int _cs149_vcompress_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { return _cs149_vcompress<float, W>(dest, src, mask); }
+template <int W>
+int _cs149_vcompress_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { return _cs149_vcompress<int, W>(dest, src, mask); }
+
+template <typename T, int W>
+HELPER void _cs149_hadd(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec) {
+  for (int i=0; i<W/2; i++) {
     T result = vec.value[2*i] + vec.value[2*i+1];
     vecResult.value[2 * i] = result;
     vecResult.value[2 * i + 1] = result;
   }
 }
 
-template void _cs149_hadd<float>(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
+template <int W>
+void _cs149_hadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec) { _cs149_hadd<float, W>(vecResult, vec); }
 
-void _cs149_hadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec) { _cs149_hadd<float>(vecResult, vec); }
-
-template <typename T>
-void _cs149_interleave(__cs149_vec<T> &vecResult, __cs149_vec<T> &vec) {
-  for (int i=0; i<VECTOR_WIDTH; i++) {
-    int index = i < VECTOR_WIDTH/2 ? (2 * i) : (2 * (i - VECTOR_WIDTH/2) + 1);
+template <typename T, int W>
+HELPER void _cs149_interleave(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec) {
+  for (int i=0; i<W; i++) {
+    int index = i < W/2 ? (2 * i) : (2 * (i - W/2) + 1);
     vecResult.value[i] = vec.value[index];
   }
 }
 
-template void _cs149_interleave<float>(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
+template <int W>
+void _cs149_interleave_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec) { _cs149_interleave<float, W>(vecResult, vec); }
+
+template <typename T, int W>
+HELPER void _cs149_vrotate(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, int k) {
+  __cs149_vec<T, W> result;
+  for (int i=0; i<W; i++) {
+    result.value[i] = vec.value[(i + k % W + W) % W];
+  }
+  vecResult = result;
+  CS149Logger.addLog("vrotate", _cs149_init_ones<W>().value, W, CALL_SITE);
+}
 
-void _cs149_interleave_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec) { _cs149_interleave<float>(vecResult, vec); }
+template <int W>
+void _cs149_vrotate_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, int k) { _cs149_vrotate<float, W>(vecResult, vec, k); }
+template <int W>
+void _cs149_vrotate_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, int k) { _cs149_vrotate<int, W>(vecResult, vec, k); }
 
 void addUserLog(const char * logStr) {
-  CS149Logger.addLog(logStr, _cs149_init_ones(), 0);
+  CS149Logger.addLog(logStr, NULL, 0, CALL_SITE);
 }
 
+// Instantiate every operation for the widths main.cpp can sweep over, and
+// for VECTOR_WIDTH if it is not one of them.
+#define INSTANTIATE_WIDTH(W)                                                                          \
+  template __cs149_mask_w<W> _cs149_init_ones<W>(int first);                                          \
+  template __cs149_mask_w<W> _cs149_mask_not<W>(__cs149_mask_w<W> &maska);                            \
+  template __cs149_mask_w<W> _cs149_mask_or<W>(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb);   \
+  template __cs149_mask_w<W> _cs149_mask_and<W>(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb);  \
+  template int _cs149_cntbits<W>(__cs149_mask_w<W> &maska);                                           \
+  template void _cs149_vset_float<W>(__cs149_vec<float, W> &vecResult, float value, __cs149_mask_w<W> &mask); \
+  template void _cs149_vset_int<W>(__cs149_vec<int, W> &vecResult, int value, __cs149_mask_w<W> &mask); \
+  template __cs149_vec<float, W> _cs149_vset_float<W>(float value);                                   \
+  template __cs149_vec<int, W> _cs149_vset_int<W>(int value);                                         \
+  INSTANTIATE_TYPED(W, float)                                                                         \
+  INSTANTIATE_TYPED(W, int)                                                                           \
+  template void _cs149_hadd_float<W>(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec);  \
+  template void _cs149_interleave_float<W>(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec);
+
+#define INSTANTIATE_TYPED(W, T)                                                                       \
+  template void _cs149_vmove_##T<W>(__cs149_vec<T, W> &dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vload_##T<W>(__cs149_vec<T, W> &dest, T* src, __cs149_mask_w<W> &mask);       \
+  template void _cs149_vstore_##T<W>(T* dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask);      \
+  template void _cs149_vadd_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vsub_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vmult_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vdiv_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vabs_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_mask_w<W> &mask); \
+  template void _cs149_vgt_##T<W>(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vlt_##T<W>(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_veq_##T<W>(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vmin_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vmax_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask); \
+  template void _cs149_vgather_##T<W>(__cs149_vec<T, W> &dest, T* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask); \
+  template void _cs149_vscatter_##T<W>(T* dest, __cs149_vec<int, W> &index, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask); \
+  template int _cs149_vcompress_##T<W>(T* dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask); \
+  template void _cs149_vrotate_##T<W>(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, int k);
+
+INSTANTIATE_WIDTH(2)
+INSTANTIATE_WIDTH(4)
+INSTANTIATE_WIDTH(8)
+INSTANTIATE_WIDTH(16)
+INSTANTIATE_WIDTH(32)
+INSTANTIATE_WIDTH(64)
+#if VECTOR_WIDTH != 2 && VECTOR_WIDTH != 4 && VECTOR_WIDTH != 8 && \
+    VECTOR_WIDTH != 16 && VECTOR_WIDTH != 32 && VECTOR_WIDTH != 64
+INSTANTIATE_WIDTH(VECTOR_WIDTH)
+#endif
+
+#endif // CS149_NATIVE
@@ -1,5 +1,7 @@
 // Define vector unit width here
+#ifndef VECTOR_WIDTH
 #define VECTOR_WIDTH 32
+#endif
 
 #ifndef CS149INTRIN_H_
 #define CS149INTRIN_H_
@@ -14,13 +16,20 @@
 
 extern Logger CS149Logger;
 
-template <typename T>
+#ifdef CS149_NATIVE
+// same types and functions, implemented with native vector instructions
+#include "CS149intrin_native.h"
+#else
+
+template <typename T, int W = VECTOR_WIDTH>
 struct __cs149_vec {
-  T value[VECTOR_WIDTH];
+  T value[W];
 };
 
-// Declare a mask with __cs149_mask
-struct __cs149_mask : __cs149_vec<bool> {};
+// Declare a mask with __cs149_mask, or __cs149_mask_w<W> for W lanes
+template <int W = VECTOR_WIDTH>
+struct __cs149_mask_w : __cs149_vec<bool, W> {};
+typedef __cs149_mask_w<> __cs149_mask;
 
 // Declare a floating point vector register with __cs149_vec_float
 #define __cs149_vec_float __cs149_vec<float>
@@ -32,95 +41,133 @@ struct __cs149_mask : __cs149_vec<bool> {};
 //* Function Definition *
 //***********************
 
+// Every function works on vectors of any width W (deduced from the
+// arguments, or VECTOR_WIDTH when there are none).  CS149intrin.cpp
+// instantiates them for W = 2, 4, ..., 64 and VECTOR_WIDTH.
+
 // Return a mask initialized to 1 in the first N lanes and 0 in the others
-__cs149_mask _cs149_init_ones(int first = VECTOR_WIDTH);
+template <int W = VECTOR_WIDTH>
+__cs149_mask_w<W> _cs149_init_ones(int first = W);
 
 // Return the inverse of maska
-__cs149_mask _cs149_mask_not(__cs149_mask &maska);
+template <int W> __cs149_mask_w<W> _cs149_mask_not(__cs149_mask_w<W> &maska);
 
 // Return (maska | maskb)
-__cs149_mask _cs149_mask_or(__cs149_mask &maska, __cs149_mask &maskb);
+template <int W> __cs149_mask_w<W> _cs149_mask_or(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb);
 
 // Return (maska & maskb)
-__cs149_mask _cs149_mask_and(__cs149_mask &maska, __cs149_mask &maskb);
+template <int W> __cs149_mask_w<W> _cs149_mask_and(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb);
 
 // Count the number of 1s in maska
-int _cs149_cntbits(__cs149_mask &maska);
+template <int W> int _cs149_cntbits(__cs149_mask_w<W> &maska);
 
 // Set register to value if vector lane is active
 //  otherwise keep the old value
-void _cs149_vset_float(__cs149_vec_float &vecResult, float value, __cs149_mask &mask);
-void _cs149_vset_int(__cs149_vec_int &vecResult, int value, __cs149_mask &mask);
+template <int W> void _cs149_vset_float(__cs149_vec<float, W> &vecResult, float value, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vset_int(__cs149_vec<int, W> &vecResult, int value, __cs149_mask_w<W> &mask);
 // For user's convenience, returns a vector register with all lanes initialized to value
-__cs149_vec_float _cs149_vset_float(float value);
-__cs149_vec_int _cs149_vset_int(int value);
+template <int W = VECTOR_WIDTH> __cs149_vec<float, W> _cs149_vset_float(float value);
+template <int W = VECTOR_WIDTH> __cs149_vec<int, W> _cs149_vset_int(int value);
 
 // Copy values from vector register src to vector register dest if vector lane active
 // otherwise keep the old value
-void _cs149_vmove_float(__cs149_vec_float &dest, __cs149_vec_float &src, __cs149_mask &mask);
-void _cs149_vmove_int(__cs149_vec_int &dest, __cs149_vec_int &src, __cs149_mask &mask);
+template <int W> void _cs149_vmove_float(__cs149_vec<float, W> &dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vmove_int(__cs149_vec<int, W> &dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask);
 
 // Load values from array src to vector register dest if vector lane active
 //  otherwise keep the old value
-void _cs149_vload_float(__cs149_vec_float &dest, float* src, __cs149_mask &mask);
-void _cs149_vload_int(__cs149_vec_int &dest, int* src, __cs149_mask &mask);
+template <int W> void _cs149_vload_float(__cs149_vec<float, W> &dest, float* src, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vload_int(__cs149_vec<int, W> &dest, int* src, __cs149_mask_w<W> &mask);
 
 // Store values from vector register src to array dest if vector lane active
 //  otherwise keep the old value
-void _cs149_vstore_float(float* dest, __cs149_vec_float &src, __cs149_mask &mask);
-void _cs149_vstore_int(int* dest, __cs149_vec_int &src, __cs149_mask &mask);
+template <int W> void _cs149_vstore_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vstore_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca + vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vadd_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W> void _cs149_vadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vadd_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca - vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vsub_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vsub_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W> void _cs149_vsub_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vsub_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca * vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vmult_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vmult_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W> void _cs149_vmult_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vmult_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return calculation of (veca / vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vdiv_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vdiv_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W> void _cs149_vdiv_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vdiv_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 
 // Return calculation of absolute value abs(veca) if vector lane active
 //  otherwise keep the old value
-void _cs149_vabs_float(__cs149_vec_float &vecResult, __cs149_vec_float &veca, __cs149_mask &mask);
-void _cs149_vabs_int(__cs149_vec_int &vecResult, __cs149_vec_int &veca, __cs149_mask &mask);
+template <int W> void _cs149_vabs_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vabs_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_mask_w<W> &mask);
 
 // Return a mask of (veca > vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vgt_float(__cs149_mask &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vgt_int(__cs149_mask &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W> void _cs149_vgt_float(__cs149_mask_w<W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vgt_int(__cs149_mask_w<W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return a mask of (veca < vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_vlt_float(__cs149_mask &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_vlt_int(__cs149_mask &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W> void _cs149_vlt_float(__cs149_mask_w<W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vlt_int(__cs149_mask_w<W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
 
 // Return a mask of (veca == vecb) if vector lane active
 //  otherwise keep the old value
-void _cs149_veq_float(__cs149_mask &vecResult, __cs149_vec_float &veca, __cs149_vec_float &vecb, __cs149_mask &mask);
-void _cs149_veq_int(__cs149_mask &vecResult, __cs149_vec_int &veca, __cs149_vec_int &vecb, __cs149_mask &mask);
+template <int W> void _cs149_veq_float(__cs149_mask_w<W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_veq_int(__cs149_mask_w<W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+
+// Return min(veca, vecb) if vector lane active
+//  otherwise keep the old value
+template <int W> void _cs149_vmin_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vmin_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+
+// Return max(veca, vecb) if vector lane active
+//  otherwise keep the old value
+template <int W> void _cs149_vmax_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vmax_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask);
+
+// Load src[index[i]] into lane i if vector lane active
+//  otherwise keep the old value
+template <int W> void _cs149_vgather_float(__cs149_vec<float, W> &dest, float* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vgather_int(__cs149_vec<int, W> &dest, int* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask);
+
+// Store lane i to dest[index[i]] if vector lane active; when two active
+//  lanes have the same index the higher lane wins
+template <int W> void _cs149_vscatter_float(float* dest, __cs149_vec<int, W> &index, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask);
+template <int W> void _cs149_vscatter_int(int* dest, __cs149_vec<int, W> &index, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask);
+
+// Store the active lanes of src to consecutive elements starting at dest,
+//  and return how many were stored, so
+//  [0 1 2 3] with mask [1 0 1 1] -> dest[0..2] = [0 2 3], returns 3
+template <int W> int _cs149_vcompress_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask);
+template <int W> int _cs149_vcompress_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask);
 
 // Adds up adjacent pairs of elements, so
 //  [0 1 2 3] -> [0+1 0+1 2+3 2+3]
-void _cs149_hadd_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
+template <int W> void _cs149_hadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec);
 
 // Performs an even-odd interleaving where all even-indexed elements move to front half
 //  of the array and odd-indexed to the back half, so
 //  [0 1 2 3 4 5 6 7] -> [0 2 4 6 1 3 5 7]
-void _cs149_interleave_float(__cs149_vec_float &vecResult, __cs149_vec_float &vec);
+template <int W> void _cs149_interleave_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec);
+
+// Rotates the elements k lanes towards lane 0, so for k = 1
+//  [0 1 2 3] -> [1 2 3 0]
+template <int W> void _cs149_vrotate_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, int k);
+template <int W> void _cs149_vrotate_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, int k);
 
 // Add a customized log to help debugging
 void addUserLog(const char * logStr);
 
+#endif // CS149_NATIVE
+
 #endif
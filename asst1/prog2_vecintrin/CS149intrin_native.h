@@ -0,0 +1,545 @@
+#ifndef CS149INTRIN_NATIVE_H_
+#define CS149INTRIN_NATIVE_H_
+
+//
+// Native backend for CS149intrin.h, selected by defining CS149_NATIVE
+// ("make BACKEND=native").  A CS149 vector of W lanes is stored as
+// W / CHUNK hardware vectors (GCC vector extensions of 4, 8 or 16 lanes
+// for SSE, AVX2 or AVX-512, or fewer when W itself is smaller), and every
+// operation is a loop over them that compiles to a few instructions per
+// chunk.  Masks are integer vectors of 0/-1 lanes and select results
+// with blends; loads and stores use the AVX masked moves.  Nothing is
+// logged.
+//
+// Note: GCC also accepts a single W-lane vector, but splits
+// wider-than-hardware comparisons and blends into scalar code, which is
+// why the chunks are explicit.
+//
+
+#include <string.h>
+#include <immintrin.h>
+
+#if defined(__AVX512F__)
+#define __CS149_HW_LANES 16
+#elif defined(__AVX__)
+#define __CS149_HW_LANES 8
+#else
+#define __CS149_HW_LANES 4
+#endif
+
+// lanes per hardware vector, and hardware vectors per CS149 vector
+template <int W>
+struct __cs149_layout {
+  static const int CHUNK = (W < __CS149_HW_LANES) ? W : __CS149_HW_LANES;
+  static const int CHUNKS = W / CHUNK;
+  static_assert(W % CHUNK == 0, "vector width must be a multiple of the hardware vector width");
+};
+
+template <typename T, int W = VECTOR_WIDTH>
+struct __cs149_vec {
+  static const int CHUNK = __cs149_layout<W>::CHUNK;
+  static const int CHUNKS = __cs149_layout<W>::CHUNKS;
+  typedef T chunk_t __attribute__((vector_size(CHUNK * sizeof(T))));
+  chunk_t value[CHUNKS];
+};
+
+// lanes are 0 (inactive) or -1 (active)
+template <int W = VECTOR_WIDTH>
+struct __cs149_mask_w : __cs149_vec<int, W> {};
+typedef __cs149_mask_w<> __cs149_mask;
+
+#define __cs149_vec_float __cs149_vec<float>
+#define __cs149_vec_int   __cs149_vec<int>
+
+// lane numbers within a chunk
+template <int W>
+static inline typename __cs149_vec<int, W>::chunk_t __cs149_lane_index() {
+  const int CHUNK = __cs149_layout<W>::CHUNK;
+  int lanes[CHUNK];
+  for (int i=0; i<CHUNK; i++) {
+    lanes[i] = i;
+  }
+  typename __cs149_vec<int, W>::chunk_t index;
+  memcpy(&index, lanes, sizeof(index));
+  return index;
+}
+
+template <typename T, int W>
+static inline typename __cs149_vec<T, W>::chunk_t __cs149_splat(T value) {
+  typename __cs149_vec<T, W>::chunk_t result = {};
+  return result + value;
+}
+
+// number of active lanes
+template <int W>
+static inline int __cs149_popcount(const __cs149_mask_w<W> &mask) {
+  const int CHUNK = __cs149_layout<W>::CHUNK;
+  typename __cs149_vec<int, W>::chunk_t sum = {};
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    sum -= mask.value[c];
+  }
+  int lanes[CHUNK];
+  memcpy(lanes, &sum, sizeof(lanes));
+  int count = 0;
+  for (int i=0; i<CHUNK; i++) {
+    count += lanes[i];
+  }
+  return count;
+}
+
+template <int W = VECTOR_WIDTH>
+inline __cs149_mask_w<W> _cs149_init_ones(int first = W) {
+  __cs149_mask_w<W> mask;
+  typename __cs149_vec<int, W>::chunk_t index = __cs149_lane_index<W>();
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    mask.value[c] = index < first - c * __cs149_layout<W>::CHUNK;
+  }
+  return mask;
+}
+
+template <int W>
+inline __cs149_mask_w<W> _cs149_mask_not(__cs149_mask_w<W> &maska) {
+  __cs149_mask_w<W> resultMask;
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    resultMask.value[c] = ~maska.value[c];
+  }
+  return resultMask;
+}
+
+template <int W>
+inline __cs149_mask_w<W> _cs149_mask_or(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb) {
+  __cs149_mask_w<W> resultMask;
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    resultMask.value[c] = maska.value[c] | maskb.value[c];
+  }
+  return resultMask;
+}
+
+template <int W>
+inline __cs149_mask_w<W> _cs149_mask_and(__cs149_mask_w<W> &maska, __cs149_mask_w<W> &maskb) {
+  __cs149_mask_w<W> resultMask;
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    resultMask.value[c] = maska.value[c] & maskb.value[c];
+  }
+  return resultMask;
+}
+
+template <int W>
+inline int _cs149_cntbits(__cs149_mask_w<W> &maska) {
+  return __cs149_popcount<W>(maska);
+}
+
+template <typename T, int W>
+inline void _cs149_vset(__cs149_vec<T, W> &vecResult, T value, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    vecResult.value[c] = mask.value[c] ? __cs149_splat<T, W>(value) : vecResult.value[c];
+  }
+}
+
+template <int W> inline void _cs149_vset_float(__cs149_vec<float, W> &vecResult, float value, __cs149_mask_w<W> &mask) { _cs149_vset<float, W>(vecResult, value, mask); }
+template <int W> inline void _cs149_vset_int(__cs149_vec<int, W> &vecResult, int value, __cs149_mask_w<W> &mask) { _cs149_vset<int, W>(vecResult, value, mask); }
+
+template <int W = VECTOR_WIDTH>
+inline __cs149_vec<float, W> _cs149_vset_float(float value) {
+  __cs149_vec<float, W> vecResult;
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    vecResult.value[c] = __cs149_splat<float, W>(value);
+  }
+  return vecResult;
+}
+template <int W = VECTOR_WIDTH>
+inline __cs149_vec<int, W> _cs149_vset_int(int value) {
+  __cs149_vec<int, W> vecResult;
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    vecResult.value[c] = __cs149_splat<int, W>(value);
+  }
+  return vecResult;
+}
+
+template <typename T, int W>
+inline void _cs149_vmove(__cs149_vec<T, W> &dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    dest.value[c] = mask.value[c] ? src.value[c] : dest.value[c];
+  }
+}
+
+template <int W> inline void _cs149_vmove_float(__cs149_vec<float, W> &dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vmove<float, W>(dest, src, mask); }
+template <int W> inline void _cs149_vmove_int(__cs149_vec<int, W> &dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vmove<int, W>(dest, src, mask); }
+
+// Masked loads and stores of one chunk.  Inactive lanes may be past the
+// end of an array, so they must not be touched: the AVX masked moves
+// suppress faults on them, and other chunk sizes copy the lanes one by
+// one.  The masked moves cost more than plain ones even with every lane
+// on, so the AVX overloads use plain unaligned moves for full chunks and
+// keep the masked ones for the partial chunk at the end of an array.
+// The overloads below are picked by chunk type.
+template <typename T, typename V, typename M>
+static inline V __cs149_maskload(const T* src, M active, V old) {
+  for (int i=0; i<(int)(sizeof(V) / sizeof(T)); i++) {
+    if (active[i]) old[i] = src[i];
+  }
+  return old;
+}
+
+template <typename T, typename V, typename M>
+static inline void __cs149_maskstore(T* dest, M active, V value) {
+  for (int i=0; i<(int)(sizeof(V) / sizeof(T)); i++) {
+    if (active[i]) dest[i] = value[i];
+  }
+}
+
+#define __CS149_CHUNK_TYPES(lanes)                                                  \
+  typedef float __cs149_float##lanes##_t __attribute__((vector_size(lanes * 4)));   \
+  typedef int __cs149_int##lanes##_t __attribute__((vector_size(lanes * 4)));
+
+__CS149_CHUNK_TYPES(4)
+__CS149_CHUNK_TYPES(8)
+__CS149_CHUNK_TYPES(16)
+
+#undef __CS149_CHUNK_TYPES
+
+#ifdef __AVX512F__
+static inline __mmask16 __cs149_kmask(__cs149_int16_t active) {
+  return _mm512_test_epi32_mask((__m512i)active, (__m512i)active);
+}
+static inline __cs149_float16_t __cs149_maskload(const float* src, __cs149_int16_t active, __cs149_float16_t old) {
+  __mmask16 k = __cs149_kmask(active);
+  if (k == 0xffff) return (__cs149_float16_t)_mm512_loadu_ps(src);
+  return (__cs149_float16_t)_mm512_mask_loadu_ps((__m512)old, k, src);
+}
+static inline __cs149_int16_t __cs149_maskload(const int* src, __cs149_int16_t active, __cs149_int16_t old) {
+  __mmask16 k = __cs149_kmask(active);
+  if (k == 0xffff) return (__cs149_int16_t)_mm512_loadu_si512(src);
+  return (__cs149_int16_t)_mm512_mask_loadu_epi32((__m512i)old, k, src);
+}
+static inline void __cs149_maskstore(float* dest, __cs149_int16_t active, __cs149_float16_t value) {
+  __mmask16 k = __cs149_kmask(active);
+  if (k == 0xffff) _mm512_storeu_ps(dest, (__m512)value);
+  else _mm512_mask_storeu_ps(dest, k, (__m512)value);
+}
+static inline void __cs149_maskstore(int* dest, __cs149_int16_t active, __cs149_int16_t value) {
+  __mmask16 k = __cs149_kmask(active);
+  if (k == 0xffff) _mm512_storeu_si512(dest, (__m512i)value);
+  else _mm512_mask_storeu_epi32(dest, k, (__m512i)value);
+}
+#endif
+
+#ifdef __AVX2__
+static inline bool __cs149_allActive(__cs149_int8_t active) {
+  return _mm256_movemask_ps((__m256)active) == 0xff;
+}
+static inline bool __cs149_allActive(__cs149_int4_t active) {
+  return _mm_movemask_ps((__m128)active) == 0xf;
+}
+
+static inline __cs149_float8_t __cs149_maskload(const float* src, __cs149_int8_t active, __cs149_float8_t old) {
+  if (__cs149_allActive(active)) return (__cs149_float8_t)_mm256_loadu_ps(src);
+  __cs149_float8_t loaded = (__cs149_float8_t)_mm256_maskload_ps(src, (__m256i)active);
+  return active ? loaded : old;
+}
+static inline __cs149_int8_t __cs149_maskload(const int* src, __cs149_int8_t active, __cs149_int8_t old) {
+  if (__cs149_allActive(active)) return (__cs149_int8_t)_mm256_loadu_si256((const __m256i*)src);
+  __cs149_int8_t loaded = (__cs149_int8_t)_mm256_maskload_epi32(src, (__m256i)active);
+  return active ? loaded : old;
+}
+static inline void __cs149_maskstore(float* dest, __cs149_int8_t active, __cs149_float8_t value) {
+  if (__cs149_allActive(active)) _mm256_storeu_ps(dest, (__m256)value);
+  else _mm256_maskstore_ps(dest, (__m256i)active, (__m256)value);
+}
+static inline void __cs149_maskstore(int* dest, __cs149_int8_t active, __cs149_int8_t value) {
+  if (__cs149_allActive(active)) _mm256_storeu_si256((__m256i*)dest, (__m256i)value);
+  else _mm256_maskstore_epi32(dest, (__m256i)active, (__m256i)value);
+}
+
+static inline __cs149_float4_t __cs149_maskload(const float* src, __cs149_int4_t active, __cs149_float4_t old) {
+  if (__cs149_allActive(active)) return (__cs149_float4_t)_mm_loadu_ps(src);
+  __cs149_float4_t loaded = (__cs149_float4_t)_mm_maskload_ps(src, (__m128i)active);
+  return active ? loaded : old;
+}
+static inline __cs149_int4_t __cs149_maskload(const int* src, __cs149_int4_t active, __cs149_int4_t old) {
+  if (__cs149_allActive(active)) return (__cs149_int4_t)_mm_loadu_si128((const __m128i*)src);
+  __cs149_int4_t loaded = (__cs149_int4_t)_mm_maskload_epi32(src, (__m128i)active);
+  return active ? loaded : old;
+}
+static inline void __cs149_maskstore(float* dest, __cs149_int4_t active, __cs149_float4_t value) {
+  if (__cs149_allActive(active)) _mm_storeu_ps(dest, (__m128)value);
+  else _mm_maskstore_ps(dest, (__m128i)active, (__m128)value);
+}
+static inline void __cs149_maskstore(int* dest, __cs149_int4_t active, __cs149_int4_t value) {
+  if (__cs149_allActive(active)) _mm_storeu_si128((__m128i*)dest, (__m128i)value);
+  else _mm_maskstore_epi32(dest, (__m128i)active, (__m128i)value);
+}
+#endif
+
+template <typename T, int W>
+inline void _cs149_vload(__cs149_vec<T, W> &dest, T* src, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    dest.value[c] = __cs149_maskload((const T*)src + c * __cs149_layout<W>::CHUNK, mask.value[c], dest.value[c]);
+  }
+}
+
+template <int W> inline void _cs149_vload_float(__cs149_vec<float, W> &dest, float* src, __cs149_mask_w<W> &mask) { _cs149_vload<float, W>(dest, src, mask); }
+template <int W> inline void _cs149_vload_int(__cs149_vec<int, W> &dest, int* src, __cs149_mask_w<W> &mask) { _cs149_vload<int, W>(dest, src, mask); }
+
+// Unlike the emulated version, only the active elements of dest are
+// written.
+template <typename T, int W>
+inline void _cs149_vstore(T* dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    __cs149_maskstore(dest + c * __cs149_layout<W>::CHUNK, mask.value[c], src.value[c]);
+  }
+}
+
+template <int W> inline void _cs149_vstore_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vstore<float, W>(dest, src, mask); }
+template <int W> inline void _cs149_vstore_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vstore<int, W>(dest, src, mask); }
+
+#define __CS149_NATIVE_BINARY(name, op)                                             \
+  template <typename T, int W>                                                      \
+  inline void _cs149_##name(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca,  \
+                            __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {     \
+    for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {                               \
+      vecResult.value[c] = mask.value[c] ? (veca.value[c] op vecb.value[c])         \
+                                         : vecResult.value[c];                      \
+    }                                                                               \
+  }                                                                                 \
+  template <int W>                                                                  \
+  inline void _cs149_##name##_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, \
+                                    __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { \
+    _cs149_##name<float, W>(vecResult, veca, vecb, mask);                           \
+  }                                                                                 \
+  template <int W>                                                                  \
+  inline void _cs149_##name##_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, \
+                                  __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { \
+    _cs149_##name<int, W>(vecResult, veca, vecb, mask);                             \
+  }
+
+__CS149_NATIVE_BINARY(vadd, +)
+__CS149_NATIVE_BINARY(vsub, -)
+__CS149_NATIVE_BINARY(vmult, *)
+
+#undef __CS149_NATIVE_BINARY
+
+template <int W>
+inline void _cs149_vdiv_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    vecResult.value[c] = mask.value[c] ? (veca.value[c] / vecb.value[c]) : vecResult.value[c];
+  }
+}
+// inactive lanes divide by 1 so that they cannot trap
+template <int W>
+inline void _cs149_vdiv_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    typename __cs149_vec<int, W>::chunk_t divisor = mask.value[c] ? vecb.value[c] : __cs149_splat<int, W>(1);
+    vecResult.value[c] = mask.value[c] ? (veca.value[c] / divisor) : vecResult.value[c];
+  }
+}
+
+template <typename T, int W>
+inline void _cs149_vabs(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca, __cs149_mask_w<W> &mask) {
+  typename __cs149_vec<T, W>::chunk_t zero = {};
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    typename __cs149_vec<T, W>::chunk_t result = (veca.value[c] < zero) ? -veca.value[c] : veca.value[c];
+    vecResult.value[c] = mask.value[c] ? result : vecResult.value[c];
+  }
+}
+
+template <int W> inline void _cs149_vabs_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, __cs149_mask_w<W> &mask) { _cs149_vabs<float, W>(vecResult, veca, mask); }
+template <int W> inline void _cs149_vabs_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, __cs149_mask_w<W> &mask) { _cs149_vabs<int, W>(vecResult, veca, mask); }
+
+#define __CS149_NATIVE_COMPARE(name, op)                                            \
+  template <typename T, int W>                                                      \
+  inline void _cs149_##name(__cs149_mask_w<W> &maskResult, __cs149_vec<T, W> &veca, \
+                            __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {     \
+    for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {                               \
+      typename __cs149_vec<int, W>::chunk_t result = (veca.value[c] op vecb.value[c]); \
+      maskResult.value[c] = mask.value[c] ? result : maskResult.value[c];           \
+    }                                                                               \
+  }                                                                                 \
+  template <int W>                                                                  \
+  inline void _cs149_##name##_float(__cs149_mask_w<W> &maskResult, __cs149_vec<float, W> &veca, \
+                                    __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { \
+    _cs149_##name<float, W>(maskResult, veca, vecb, mask);                          \
+  }                                                                                 \
+  template <int W>                                                                  \
+  inline void _cs149_##name##_int(__cs149_mask_w<W> &maskResult, __cs149_vec<int, W> &veca, \
+                                  __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { \
+    _cs149_##name<int, W>(maskResult, veca, vecb, mask);                            \
+  }
+
+__CS149_NATIVE_COMPARE(vgt, >)
+__CS149_NATIVE_COMPARE(vlt, <)
+__CS149_NATIVE_COMPARE(veq, ==)
+
+#undef __CS149_NATIVE_COMPARE
+
+#define __CS149_NATIVE_SELECT(name, op)                                             \
+  template <typename T, int W>                                                      \
+  inline void _cs149_##name(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &veca,  \
+                            __cs149_vec<T, W> &vecb, __cs149_mask_w<W> &mask) {     \
+    for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {                               \
+      typename __cs149_vec<T, W>::chunk_t result =                                  \
+          (veca.value[c] op vecb.value[c]) ? veca.value[c] : vecb.value[c];         \
+      vecResult.value[c] = mask.value[c] ? result : vecResult.value[c];             \
+    }                                                                               \
+  }                                                                                 \
+  template <int W>                                                                  \
+  inline void _cs149_##name##_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &veca, \
+                                    __cs149_vec<float, W> &vecb, __cs149_mask_w<W> &mask) { \
+    _cs149_##name<float, W>(vecResult, veca, vecb, mask);                           \
+  }                                                                                 \
+  template <int W>                                                                  \
+  inline void _cs149_##name##_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &veca, \
+                                  __cs149_vec<int, W> &vecb, __cs149_mask_w<W> &mask) { \
+    _cs149_##name<int, W>(vecResult, veca, vecb, mask);                             \
+  }
+
+__CS149_NATIVE_SELECT(vmin, <)
+__CS149_NATIVE_SELECT(vmax, >)
+
+#undef __CS149_NATIVE_SELECT
+
+// Gathers, scatters and compress-stores of one chunk, again picked by
+// chunk type.  AVX2 has gathers only; scatters and compress-stores need
+// AVX-512 and otherwise go lane by lane, in lane order.
+template <typename T, typename V, typename M>
+static inline V __cs149_gather(const T* src, M index, M active, V old) {
+  for (int i=0; i<(int)(sizeof(V) / sizeof(T)); i++) {
+    if (active[i]) old[i] = src[index[i]];
+  }
+  return old;
+}
+
+template <typename T, typename V, typename M>
+static inline void __cs149_scatter(T* dest, M index, M active, V value) {
+  for (int i=0; i<(int)(sizeof(V) / sizeof(T)); i++) {
+    if (active[i]) dest[index[i]] = value[i];
+  }
+}
+
+template <typename T, typename V, typename M>
+static inline int __cs149_compress(T* dest, M active, V value) {
+  int count = 0;
+  for (int i=0; i<(int)(sizeof(V) / sizeof(T)); i++) {
+    if (active[i]) dest[count++] = value[i];
+  }
+  return count;
+}
+
+#ifdef __AVX512F__
+static inline __cs149_float16_t __cs149_gather(const float* src, __cs149_int16_t index, __cs149_int16_t active, __cs149_float16_t old) {
+  return (__cs149_float16_t)_mm512_mask_i32gather_ps((__m512)old, __cs149_kmask(active), (__m512i)index, src, 4);
+}
+static inline __cs149_int16_t __cs149_gather(const int* src, __cs149_int16_t index, __cs149_int16_t active, __cs149_int16_t old) {
+  return (__cs149_int16_t)_mm512_mask_i32gather_epi32((__m512i)old, __cs149_kmask(active), (__m512i)index, src, 4);
+}
+// overlapping lanes are written from low to high, so the highest wins
+static inline void __cs149_scatter(float* dest, __cs149_int16_t index, __cs149_int16_t active, __cs149_float16_t value) {
+  _mm512_mask_i32scatter_ps(dest, __cs149_kmask(active), (__m512i)index, (__m512)value, 4);
+}
+static inline void __cs149_scatter(int* dest, __cs149_int16_t index, __cs149_int16_t active, __cs149_int16_t value) {
+  _mm512_mask_i32scatter_epi32(dest, __cs149_kmask(active), (__m512i)index, (__m512i)value, 4);
+}
+static inline int __cs149_compress(float* dest, __cs149_int16_t active, __cs149_float16_t value) {
+  __mmask16 k = __cs149_kmask(active);
+  _mm512_mask_compressstoreu_ps(dest, k, (__m512)value);
+  return __builtin_popcount(k);
+}
+static inline int __cs149_compress(int* dest, __cs149_int16_t active, __cs149_int16_t value) {
+  __mmask16 k = __cs149_kmask(active);
+  _mm512_mask_compressstoreu_epi32(dest, k, (__m512i)value);
+  return __builtin_popcount(k);
+}
+#endif
+
+#ifdef __AVX2__
+static inline __cs149_float8_t __cs149_gather(const float* src, __cs149_int8_t index, __cs149_int8_t active, __cs149_float8_t old) {
+  return (__cs149_float8_t)_mm256_mask_i32gather_ps((__m256)old, src, (__m256i)index, (__m256)active, 4);
+}
+static inline __cs149_int8_t __cs149_gather(const int* src, __cs149_int8_t index, __cs149_int8_t active, __cs149_int8_t old) {
+  return (__cs149_int8_t)_mm256_mask_i32gather_epi32((__m256i)old, src, (__m256i)index, (__m256i)active, 4);
+}
+static inline __cs149_float4_t __cs149_gather(const float* src, __cs149_int4_t index, __cs149_int4_t active, __cs149_float4_t old) {
+  return (__cs149_float4_t)_mm_mask_i32gather_ps((__m128)old, src, (__m128i)index, (__m128)active, 4);
+}
+static inline __cs149_int4_t __cs149_gather(const int* src, __cs149_int4_t index, __cs149_int4_t active, __cs149_int4_t old) {
+  return (__cs149_int4_t)_mm_mask_i32gather_epi32((__m128i)old, src, (__m128i)index, (__m128i)active, 4);
+}
+#endif
+
+template <typename T, int W>
+inline void _cs149_vgather(__cs149_vec<T, W> &dest, T* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    dest.value[c] = __cs149_gather((const T*)src, index.value[c], mask.value[c], dest.value[c]);
+  }
+}
+
+template <int W> inline void _cs149_vgather_float(__cs149_vec<float, W> &dest, float* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vgather<float, W>(dest, src, index, mask); }
+template <int W> inline void _cs149_vgather_int(__cs149_vec<int, W> &dest, int* src, __cs149_vec<int, W> &index, __cs149_mask_w<W> &mask) { _cs149_vgather<int, W>(dest, src, index, mask); }
+
+template <typename T, int W>
+inline void _cs149_vscatter(T* dest, __cs149_vec<int, W> &index, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    __cs149_scatter(dest, index.value[c], mask.value[c], src.value[c]);
+  }
+}
+
+template <int W> inline void _cs149_vscatter_float(float* dest, __cs149_vec<int, W> &index, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { _cs149_vscatter<float, W>(dest, index, src, mask); }
+template <int W> inline void _cs149_vscatter_int(int* dest, __cs149_vec<int, W> &index, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { _cs149_vscatter<int, W>(dest, index, src, mask); }
+
+template <typename T, int W>
+inline int _cs149_vcompress(T* dest, __cs149_vec<T, W> &src, __cs149_mask_w<W> &mask) {
+  int count = 0;
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    count += __cs149_compress(dest + count, mask.value[c], src.value[c]);
+  }
+  return count;
+}
+
+template <int W> inline int _cs149_vcompress_float(float* dest, __cs149_vec<float, W> &src, __cs149_mask_w<W> &mask) { return _cs149_vcompress<float, W>(dest, src, mask); }
+template <int W> inline int _cs149_vcompress_int(int* dest, __cs149_vec<int, W> &src, __cs149_mask_w<W> &mask) { return _cs149_vcompress<int, W>(dest, src, mask); }
+
+// pairs never straddle two chunks, since chunks have an even number of lanes
+template <int W>
+inline void _cs149_hadd_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec) {
+  typename __cs149_vec<int, W>::chunk_t swapPairs = __cs149_lane_index<W>() ^ 1;
+  for (int c=0; c<__cs149_layout<W>::CHUNKS; c++) {
+    vecResult.value[c] = vec.value[c] + __builtin_shuffle(vec.value[c], swapPairs);
+  }
+}
+
+// moves lanes across chunks, so this one goes through memory
+template <int W>
+inline void _cs149_interleave_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec) {
+  float lanes[W], result[W];
+  memcpy(lanes, vec.value, sizeof(lanes));
+  for (int i=0; i<W; i++) {
+    int index = (i < W/2) ? (2 * i) : (2 * (i - W/2) + 1);
+    result[i] = lanes[index];
+  }
+  memcpy(vecResult.value, result, sizeof(result));
+}
+
+// Whole chunks just move; a rotation within chunks takes every output
+// chunk from two neighbouring input chunks with one two-operand shuffle.
+template <typename T, int W>
+inline void _cs149_vrotate(__cs149_vec<T, W> &vecResult, __cs149_vec<T, W> &vec, int k) {
+  const int CHUNK = __cs149_layout<W>::CHUNK;
+  const int CHUNKS = __cs149_layout<W>::CHUNKS;
+  k = (k % W + W) % W;
+  int chunkShift = k / CHUNK, laneShift = k % CHUNK;
+  typename __cs149_vec<int, W>::chunk_t select = __cs149_lane_index<W>() + laneShift;
+  __cs149_vec<T, W> result;
+  for (int c=0; c<CHUNKS; c++) {
+    typename __cs149_vec<T, W>::chunk_t lo = vec.value[(c + chunkShift) % CHUNKS];
+    typename __cs149_vec<T, W>::chunk_t hi = vec.value[(c + chunkShift + 1) % CHUNKS];
+    result.value[c] = (laneShift == 0) ? lo : __builtin_shuffle(lo, hi, select);
+  }
+  vecResult = result;
+}
+
+template <int W> inline void _cs149_vrotate_float(__cs149_vec<float, W> &vecResult, __cs149_vec<float, W> &vec, int k) { _cs149_vrotate<float, W>(vecResult, vec, k); }
+template <int W> inline void _cs149_vrotate_int(__cs149_vec<int, W> &vecResult, __cs149_vec<int, W> &vec, int k) { _cs149_vrotate<int, W>(vecResult, vec, k); }
+
+inline void addUserLog(const char * logStr) {}
+
+#endif
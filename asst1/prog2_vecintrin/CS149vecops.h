@@ -0,0 +1,162 @@
+#ifndef CS149VECOPS_H_
+#define CS149VECOPS_H_
+
+//
+// Data-parallel building blocks written with the CS149 intrinsics:
+// reductions, an exclusive prefix sum, gather/scatter and stream
+// compaction over float arrays.  They take any N (the last vector is
+// masked) and any power-of-two width W, and run on whichever backend
+// CS149intrin.h was built with.
+//
+// Reductions within a vector are a log2(W) tree of rotations, and the
+// prefix sum within a vector is the log2(W)-step Hillis-Steele scan, so
+// float results can differ from a left-to-right serial loop by rounding.
+//
+
+#include <math.h>
+#include "CS149intrin.h"
+
+//
+// In-register helpers.  The reductions leave the result in every lane.
+//
+
+#define __CS149_REDUCE_LANES(name, op)                                              \
+  template <int W>                                                                  \
+  void name(__cs149_vec<float, W> &vec) {                                           \
+    static_assert((W & (W - 1)) == 0, "vector width must be a power of two");       \
+    __cs149_mask_w<W> maskAll = _cs149_init_ones<W>();                              \
+    __cs149_vec<float, W> rotated;                                                  \
+    for (int k=W/2; k>=1; k/=2) {                                                   \
+      _cs149_vrotate_float(rotated, vec, k);                                        \
+      op(vec, vec, rotated, maskAll);                                               \
+    }                                                                               \
+  }
+
+__CS149_REDUCE_LANES(reduceAddLanes, _cs149_vadd_float)
+__CS149_REDUCE_LANES(reduceMinLanes, _cs149_vmin_float)
+__CS149_REDUCE_LANES(reduceMaxLanes, _cs149_vmax_float)
+
+#undef __CS149_REDUCE_LANES
+
+// vec[i] = vec[0] + ... + vec[i]
+template <int W>
+void inclusiveScanLanes(__cs149_vec<float, W> &vec) {
+  __cs149_vec<float, W> shifted;
+  for (int d=1; d<W; d*=2) {
+    // lanes d and up add the lane d below them
+    __cs149_mask_w<W> below = _cs149_init_ones<W>(d);
+    __cs149_mask_w<W> maskAdd = _cs149_mask_not(below);
+    _cs149_vrotate_float(shifted, vec, -d);
+    _cs149_vadd_float(vec, vec, shifted, maskAdd);
+  }
+}
+
+// value of lane 0
+template <int W>
+float firstLane(__cs149_vec<float, W> &vec) {
+  float lanes[W];
+  __cs149_mask_w<W> first = _cs149_init_ones<W>(1);
+  _cs149_vstore_float(lanes, vec, first);
+  return lanes[0];
+}
+
+//
+// Array operations
+//
+
+#define __CS149_REDUCE_ARRAY(name, lanes, op, identity)                             \
+  template <int W>                                                                  \
+  float name(float* values, int N) {                                                \
+    __cs149_vec<float, W> acc = _cs149_vset_float<W>(identity);                     \
+    __cs149_vec<float, W> x;                                                        \
+    for (int i=0; i<N; i+=W) {                                                      \
+      __cs149_mask_w<W> maskValid = _cs149_init_ones<W>(N - i);                     \
+      _cs149_vload_float(x, values+i, maskValid);                                   \
+      op(acc, acc, x, maskValid);                                                   \
+    }                                                                               \
+    lanes<W>(acc);                                                                  \
+    return firstLane<W>(acc);                                                       \
+  }
+
+// sum, minimum and maximum of values[0..N-1]; 0, +inf and -inf for N = 0
+__CS149_REDUCE_ARRAY(reduceAddVector, reduceAddLanes, _cs149_vadd_float, 0.f)
+__CS149_REDUCE_ARRAY(reduceMinVector, reduceMinLanes, _cs149_vmin_float, INFINITY)
+__CS149_REDUCE_ARRAY(reduceMaxVector, reduceMaxLanes, _cs149_vmax_float, -INFINITY)
+
+#undef __CS149_REDUCE_ARRAY
+
+// output[i] = values[0] + ... + values[i-1], output[0] = 0
+template <int W>
+void exclusiveScanVector(float* values, float* output, int N) {
+  float carry = 0.f;
+  float lanes[W];
+  __cs149_vec<float, W> x, shifted;
+  __cs149_mask_w<W> maskAll = _cs149_init_ones<W>();
+  __cs149_mask_w<W> first = _cs149_init_ones<W>(1);
+
+  for (int i=0; i<N; i+=W) {
+    int n = (N - i < W) ? N - i : W;
+    __cs149_mask_w<W> maskValid = _cs149_init_ones<W>(n);
+
+    // lanes past N scan zeros
+    x = _cs149_vset_float<W>(0.f);
+    _cs149_vload_float(x, values+i, maskValid);
+    inclusiveScanLanes<W>(x);
+    __cs149_vec<float, W> carryVec = _cs149_vset_float<W>(carry);
+    _cs149_vadd_float(x, x, carryVec, maskAll);
+
+    // shift up by one lane, with the incoming carry in lane 0
+    _cs149_vrotate_float(shifted, x, -1);
+    _cs149_vset_float(shifted, carry, first);
+    _cs149_vstore_float(output+i, shifted, maskValid);
+
+    _cs149_vstore_float(lanes, x, maskAll);
+    carry = lanes[n-1];
+  }
+}
+
+// output[i] = values[index[i]]
+template <int W>
+void gatherVector(float* values, int* index, float* output, int N) {
+  __cs149_vec<int, W> idx;
+  __cs149_vec<float, W> x;
+  for (int i=0; i<N; i+=W) {
+    __cs149_mask_w<W> maskValid = _cs149_init_ones<W>(N - i);
+    _cs149_vload_int(idx, index+i, maskValid);
+    _cs149_vgather_float(x, values, idx, maskValid);
+    _cs149_vstore_float(output+i, x, maskValid);
+  }
+}
+
+// output[index[i]] = values[i], in increasing i, so the last of several
+// equal indices wins as it would in a serial loop
+template <int W>
+void scatterVector(float* values, int* index, float* output, int N) {
+  __cs149_vec<int, W> idx;
+  __cs149_vec<float, W> x;
+  for (int i=0; i<N; i+=W) {
+    __cs149_mask_w<W> maskValid = _cs149_init_ones<W>(N - i);
+    _cs149_vload_int(idx, index+i, maskValid);
+    _cs149_vload_float(x, values+i, maskValid);
+    _cs149_vscatter_float(output, idx, x, maskValid);
+  }
+}
+
+// Copies the values greater than threshold to the front of output, in
+// order, and returns how many there are.
+template <int W>
+int compressGreaterVector(float* values, float threshold, float* output, int N) {
+  int count = 0;
+  __cs149_vec<float, W> x;
+  __cs149_vec<float, W> limit = _cs149_vset_float<W>(threshold);
+  for (int i=0; i<N; i+=W) {
+    __cs149_mask_w<W> maskValid = _cs149_init_ones<W>(N - i);
+    __cs149_mask_w<W> maskKeep = _cs149_init_ones<W>(0);
+    _cs149_vload_float(x, values+i, maskValid);
+    _cs149_vgt_float(maskKeep, x, limit, maskValid);
+    count += _cs149_vcompress_float(output+count, x, maskKeep);
+  }
+  return count;
+}
+
+#endif
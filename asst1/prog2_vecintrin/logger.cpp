@@ -1,24 +1,116 @@
 #include "logger.h"
 #include "CS149intrin.h"
+#include <stdint.h>
+#include <algorithm>
+#include <dlfcn.h>
+#include <cxxabi.h>
 
-void Logger::addLog(const char * instruction, __cs149_mask mask, int N) {
-  Log newLog;
-  strcpy(newLog.instruction, instruction);
-  newLog.mask = 0;
+Logger::Logger() {
+  mode = LOG_TRACE;
+  reset(VECTOR_WIDTH);
+}
+
+void Logger::setMode(LogMode newMode) {
+  mode = newMode;
+  if (mode == LOG_PROFILE) {
+    vector<Log>().swap(log);
+  }
+}
+
+void Logger::addLog(const char * instruction, const bool * mask, int N, const void * site) {
+  unsigned long long laneMask = 0;
+  int utilized = 0;
   for (int i=0; i<N; i++) {
-    if (mask.value[i]) {
-      newLog.mask |= (((unsigned long long)1)<<i);
-      stats.utilized_lane++;
+    if (mask[i]) {
+      laneMask |= (((unsigned long long)1)<<i);
+      utilized++;
     }
   }
+  stats.utilized_lane += utilized;
   stats.total_lane += N;
   stats.total_instructions += (N>0);
-  log.push_back(newLog);
+  if (N > 0) stats.vector_width = N;
+
+  profile(instruction, site, utilized, N);
+
+  if (mode == LOG_TRACE) {
+    Log newLog;
+    strcpy(newLog.instruction, instruction);
+    newLog.mask = laneMask;
+    newLog.width = N;
+    log.push_back(newLog);
+  }
+}
+
+void Logger::profile(const char * instruction, const void * site, int utilized, int N) {
+  int type = 0;
+  while (type < numInstructions &&
+         strncmp(instructions[type].instruction, instruction, MAX_INST_LEN - 1) != 0) {
+    type++;
+  }
+  if (type == numInstructions) {
+    if (numInstructions == MAX_INST_TYPES) {
+      unprofiled_instructions++;
+      return;
+    }
+    InstructionProfile &newType = instructions[numInstructions++];
+    memset(&newType, 0, sizeof(newType));
+    strncpy(newType.instruction, instruction, MAX_INST_LEN - 1);
+  }
+  instructions[type].count++;
+  instructions[type].utilized_lane += utilized;
+  instructions[type].total_lane += N;
+
+  if (N == 0 || N > MAX_LANES) return;
+
+  // open addressing on the return address
+  int slot = (int)(((uintptr_t)site >> 2) % MAX_CALL_SITES);
+  for (int probe=0; probe<MAX_CALL_SITES; probe++) {
+    CallSiteProfile &entry = callSites[slot];
+    if (entry.count == 0) {
+      memset(&entry, 0, sizeof(entry));
+      entry.site = site;
+      strcpy(entry.instruction, instructions[type].instruction);
+      entry.width = N;
+      numCallSites++;
+    }
+    if (entry.site == site && entry.width == N) {
+      entry.count++;
+      entry.utilized_lane += utilized;
+      entry.histogram[utilized]++;
+      return;
+    }
+    slot = (slot + 1) % MAX_CALL_SITES;
+  }
+  unprofiled_instructions++;
+}
+
+// "function+0xoffset" for a code address; needs -rdynamic for names
+static void describeSite(const void * site, char * buf, int len) {
+  Dl_info info;
+  if (site == NULL || !dladdr(site, &info)) {
+    snprintf(buf, len, "%p", site);
+    return;
+  }
+  if (info.dli_sname == NULL) {
+    snprintf(buf, len, "%s+0x%lx", info.dli_fname,
+             (unsigned long)((uintptr_t)site - (uintptr_t)info.dli_fbase));
+    return;
+  }
+  int status;
+  char * demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+  snprintf(buf, len, "%s+0x%lx", status == 0 ? demangled : info.dli_sname,
+           (unsigned long)((uintptr_t)site - (uintptr_t)info.dli_saddr));
+  free(demangled);
 }
 
 void Logger::printStats() {
   printf("****************** Printing Vector Unit Statistics *******************\n");
-  printf("Vector Width:              %d\n", VECTOR_WIDTH);
+  printf("Vector Width:              %d\n", stats.vector_width);
+#ifdef CS149_NATIVE
+  printf("(not collected by the native backend)\n");
+  return;
+#endif
   printf("Total Vector Instructions: %lld\n", stats.total_instructions);
   printf("Vector Utilization:        %.1f%%\n", (double)stats.utilized_lane/stats.total_lane*100);
   printf("Utilized Vector Lanes:     %lld\n", stats.utilized_lane);
@@ -33,7 +125,7 @@ void Logger::printLog() {
   printf("------------- --------------------------------------------------------\n");
   for (int i=0; i<log.size(); i++) {
     printf("%12s | ", log[i].instruction);
-    for (int j=0; j<VECTOR_WIDTH; j++) {
+    for (int j=0; j<log[i].width; j++) {
       if (log[i].mask & (((unsigned long long)1)<<j)) {
         printf("*");
       } else {
@@ -44,3 +136,78 @@ void Logger::printLog() {
   }
 }
 
+void Logger::printProfile(int maxCallSites) {
+  printf("******************* Printing Vector Unit Profile *********************\n");
+#ifdef CS149_NATIVE
+  printf("(not collected by the native backend)\n");
+  return;
+#endif
+  printf(" Instruction |        Count | Utilization\n");
+  printf("------------- -------------- ------------\n");
+  for (int i=0; i<numInstructions; i++) {
+    InstructionProfile &type = instructions[i];
+    if (type.total_lane > 0) {
+      printf("%12s | %12llu | %10.1f%%\n", type.instruction, type.count,
+             (double)type.utilized_lane / type.total_lane * 100);
+    } else {
+      printf("%12s | %12llu |\n", type.instruction, type.count);
+    }
+  }
+
+  // call sites with the most idle lanes first
+  vector<CallSiteProfile *> sites;
+  for (int i=0; i<MAX_CALL_SITES; i++) {
+    if (callSites[i].count > 0) sites.push_back(&callSites[i]);
+  }
+  std::sort(sites.begin(), sites.end(), [](CallSiteProfile *a, CallSiteProfile *b) {
+    return a->count * a->width - a->utilized_lane > b->count * b->width - b->utilized_lane;
+  });
+
+  printf("\nCall sites (%d of %d, most idle lanes first), executions by active lanes:\n",
+         std::min(maxCallSites, (int)sites.size()), (int)sites.size());
+  printf(" Instruction |      Count |  Util |   none |  <=25%% |  <=50%% |  <=75%% |  <100%% |    all | Site\n");
+  for (int i=0; i<(int)sites.size() && i<maxCallSites; i++) {
+    CallSiteProfile &site = *sites[i];
+    unsigned long long buckets[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int k=0; k<=site.width; k++) {
+      int bucket = (k == 0) ? 0 : (k == site.width) ? 5 : 1 + (4 * k - 1) / site.width;
+      buckets[bucket] += site.histogram[k];
+    }
+    char where[256];
+    describeSite(site.site, where, sizeof(where));
+    printf("%12s | %10llu | %4.1f%%", site.instruction, site.count,
+           (double)site.utilized_lane / (site.count * site.width) * 100);
+    for (int b=0; b<6; b++) {
+      printf(" | %5.1f%%", (double)buckets[b] / site.count * 100);
+    }
+    printf(" | %s\n", where);
+  }
+  if (unprofiled_instructions > 0) {
+    printf("(%llu instructions did not fit in the profile tables)\n", unprofiled_instructions);
+  }
+}
+
+void Logger::printFlame(FILE * out) {
+  for (int i=0; i<MAX_CALL_SITES; i++) {
+    CallSiteProfile &site = callSites[i];
+    if (site.count == 0) continue;
+    char where[256];
+    describeSite(site.site, where, sizeof(where));
+    unsigned long long total = site.count * site.width;
+    fprintf(out, "%s;%s;active %llu\n", where, site.instruction, site.utilized_lane);
+    fprintf(out, "%s;%s;idle %llu\n", where, site.instruction, total - site.utilized_lane);
+  }
+}
+
+void Logger::reset(int vectorWidth) {
+  log.clear();
+  memset(instructions, 0, sizeof(instructions));
+  numInstructions = 0;
+  memset(callSites, 0, sizeof(callSites));
+  numCallSites = 0;
+  unprofiled_instructions = 0;
+  stats.utilized_lane = 0;
+  stats.total_lane = 0;
+  stats.total_instructions = 0;
+  stats.vector_width = vectorWidth;
+}
@@ -8,28 +8,80 @@ using namespace std;
 
 #define MAX_INST_LEN 32
 
-struct __cs149_mask;
+// sizes of the profile tables; instruction types and call sites past
+// these limits are counted in the totals only
+#define MAX_INST_TYPES 32
+#define MAX_CALL_SITES 256
+#define MAX_LANES 64
+
+// LOG_TRACE keeps a record of every instruction for printLog, which
+// costs memory in proportion to the run.  LOG_PROFILE only updates the
+// fixed-size counters below, so it can watch runs of any length.
+enum LogMode { LOG_TRACE, LOG_PROFILE };
 
 struct Log {
   char instruction[MAX_INST_LEN];
   unsigned long long mask; // support vector width up to 64
+  int width;
 };
 
 struct Statistics {
   unsigned long long utilized_lane;
   unsigned long long total_lane;
   unsigned long long total_instructions;
+  int vector_width;
+};
+
+// names are copied, since addUserLog callers may pass a buffer they
+// reuse; like Log, they are truncated to MAX_INST_LEN-1 characters
+struct InstructionProfile {
+  char instruction[MAX_INST_LEN];
+  unsigned long long count;
+  unsigned long long utilized_lane;
+  unsigned long long total_lane;
+};
+
+// one vector instruction in the user's code, identified by its return
+// address
+struct CallSiteProfile {
+  const void * site;
+  char instruction[MAX_INST_LEN];
+  int width;
+  unsigned long long count;
+  unsigned long long utilized_lane;
+  // number of executions with k active lanes
+  unsigned long long histogram[MAX_LANES + 1];
 };
 
 class Logger {
   private:
     vector<Log> log;
     Statistics stats;
+    LogMode mode;
+    InstructionProfile instructions[MAX_INST_TYPES];
+    int numInstructions;
+    CallSiteProfile callSites[MAX_CALL_SITES];
+    int numCallSites;
+    unsigned long long unprofiled_instructions;
+
+    void profile(const char * instruction, const void * site, int utilized, int N);
 
   public:
-    void addLog(const char * instruction, __cs149_mask mask, int N = 0);
+    Logger();
+    // mask holds the N lanes of the instruction, and site is the return
+    // address of the intrinsic that executed it
+    void addLog(const char * instruction, const bool * mask, int N = 0,
+                const void * site = NULL);
+    void setMode(LogMode newMode);
     void printStats();
     void printLog();
+    // per-instruction and per-call-site utilization, worst sites first
+    void printProfile(int maxCallSites = 16);
+    // one "function;instruction;active|idle lanes" line per call site, in
+    // the folded format read by flame graph tools
+    void printFlame(FILE * out);
+    // forget all logged instructions, e.g. before switching vector width
+    void reset(int vectorWidth);
 };
 
 #endif
@@ -2,38 +2,79 @@
 #include <algorithm>
 #include <getopt.h>
 #include <math.h>
+#include <vector>
 #include "CS149intrin.h"
+#include "CS149vecops.h"
 #include "logger.h"
+#include "CycleTimer.h"
 using namespace std;
 
 #define EXP_MAX 10
 
+// widest vector --sweep runs; arrays are padded by PADDING elements so
+// that full-width vector operations past N stay inside them
+#define MAX_SWEEP_WIDTH 64
+#define PADDING (VECTOR_WIDTH > MAX_SWEEP_WIDTH ? VECTOR_WIDTH : MAX_SWEEP_WIDTH)
+
 Logger CS149Logger;
 
+// minimum time of three runs of kernel().  The log is reset before each
+// run, so the statistics printed afterwards describe one run.
+template <typename Kernel>
+static double minTime(Kernel kernel, int width = VECTOR_WIDTH) {
+  double minKernel = 1e30;
+  for (int i = 0; i < 3; ++i) {
+    CS149Logger.reset(width);
+    double startTime = CycleTimer::currentSeconds();
+    kernel();
+    double endTime = CycleTimer::currentSeconds();
+    minKernel = std::min(minKernel, endTime - startTime);
+  }
+  return minKernel;
+}
+
 void usage(const char* progname);
-void initValue(float* values, int* exponents, float* output, float* gold, unsigned int N);
+void initValue(float* values, int* exponents, float* output, float* gold, unsigned int N,
+               bool divergent);
 void absSerial(float* values, float* output, int N);
 void absVector(float* values, float* output, int N);
 void clampedExpSerial(float* values, int* exponents, float* output, int N);
+template <int W = VECTOR_WIDTH>
 void clampedExpVector(float* values, int* exponents, float* output, int N);
+template <int W = VECTOR_WIDTH>
+void clampedExpCompactVector(float* values, int* exponents, float* output, int N);
+template <int W>
+bool sweepWidth(float* values, int* exponents, float* output, float* gold, int N);
 float arraySumSerial(float* values, int N);
 float arraySumVector(float* values, int N);
 bool verifyResult(float* values, int* exponents, float* output, float* gold, int N);
+template <int W>
+bool checkVecops();
 
 int main(int argc, char * argv[]) {
   int N = 16;
   bool printLog = false;
+  bool sweep = false;
+  bool printProfile = false;
+  const char* flameFile = NULL;
+  bool check = false;
+  bool divergent = false;
 
   // parse commandline options ////////////////////////////////////////////
   int opt;
   static struct option long_options[] = {
     {"size", 1, 0, 's'},
     {"log", 0, 0, 'l'},
+    {"sweep", 0, 0, 'w'},
+    {"profile", 0, 0, 'p'},
+    {"flame", 1, 0, 'f'},
+    {"check", 0, 0, 'c'},
+    {"divergent", 0, 0, 'd'},
     {"help", 0, 0, '?'},
     {0 ,0, 0, 0}
   };
 
-  while ((opt = getopt_long(argc, argv, "s:l?", long_options, NULL)) != EOF) {
+  while ((opt = getopt_long(argc, argv, "s:lwpf:cd?", long_options, NULL)) != EOF) {
 
     switch (opt) {
       case 's':
@@ -46,6 +87,21 @@ int main(int argc, char * argv[]) {
       case 'l':
         printLog = true;
         break;
+      case 'w':
+        sweep = true;
+        break;
+      case 'p':
+        printProfile = true;
+        break;
+      case 'f':
+        flameFile = optarg;
+        break;
+      case 'c':
+        check = true;
+        break;
+      case 'd':
+        divergent = true;
+        break;
       case '?':
       default:
         usage(argv[0]);
@@ -54,22 +110,44 @@ int main(int argc, char * argv[]) {
   }
 
 
-  float* values = new float[N+VECTOR_WIDTH];
-  int* exponents = new int[N+VECTOR_WIDTH];
-  float* output = new float[N+VECTOR_WIDTH];
-  float* gold = new float[N+VECTOR_WIDTH];
-  initValue(values, exponents, output, gold, N);
+  // only printLog needs a record of every instruction
+  CS149Logger.setMode(printLog ? LOG_TRACE : LOG_PROFILE);
+
+  if (check) {
+    printf("\e[1;31mVECTOR LIBRARY CHECK\e[0m \n");
+    bool checkCorrect = checkVecops<2>() && checkVecops<4>() && checkVecops<8>() &&
+                        checkVecops<16>() && checkVecops<32>() && checkVecops<64>();
+    if (!checkCorrect) {
+      printf("@@@ Failed!!!\n");
+      return 1;
+    }
+    printf("Passed!!!\n");
+    return 0;
+  }
 
-  clampedExpSerial(values, exponents, gold, N);
-  clampedExpVector(values, exponents, output, N);
+  float* values = new float[N+PADDING];
+  int* exponents = new int[N+PADDING];
+  float* output = new float[N+PADDING];
+  float* gold = new float[N+PADDING];
+  initValue(values, exponents, output, gold, N, divergent);
 
-  //absSerial(values, gold, N);
-  //absVector(values, output, N);
+  double serialTime = minTime([&] { clampedExpSerial(values, exponents, gold, N); });
+  double vectorTime = minTime([&] { clampedExpVector(values, exponents, output, N); });
 
   printf("\e[1;31mCLAMPED EXPONENT\e[0m (required) \n");
   bool clampedCorrect = verifyResult(values, exponents, output, gold, N);
   if (printLog) CS149Logger.printLog();
   CS149Logger.printStats();
+  if (printProfile) CS149Logger.printProfile();
+  if (flameFile) {
+    FILE* out = fopen(flameFile, "w");
+    if (out) {
+      CS149Logger.printFlame(out);
+      fclose(out);
+    } else {
+      printf("Error: could not open %s\n", flameFile);
+    }
+  }
 
   printf("************************ Result Verification *************************\n");
   if (!clampedCorrect) {
@@ -77,22 +155,75 @@ int main(int argc, char * argv[]) {
   } else {
     printf("Passed!!!\n");
   }
+  printf("[clamped exp serial]:\t[%.3f] ms\n", serialTime * 1000);
+  printf("[clamped exp vector]:\t[%.3f] ms\t(%.2fx speedup)\n",
+         vectorTime * 1000, serialTime / vectorTime);
 
-  printf("\n\e[1;31mARRAY SUM\e[0m (bonus) \n");
-  if (N % VECTOR_WIDTH == 0) {
-    float sumGold = arraySumSerial(values, N);
-    float sumOutput = arraySumVector(values, N);
-    float epsilon = 0.1;
-    bool sumCorrect = abs(sumGold - sumOutput) < epsilon * 2;
-    if (!sumCorrect) {
-      printf("Expected %f, got %f\n.", sumGold, sumOutput);
+  printf("\n\e[1;31mCLAMPED EXPONENT, COMPACTED LANES\e[0m \n");
+  for (int i=0; i<N+PADDING; i++) {
+    output[i] = 0.f;
+  }
+  double compactTime = minTime([&] { clampedExpCompactVector(values, exponents, output, N); });
+
+  if (!verifyResult(values, exponents, output, gold, N)) {
+    printf("@@@ Failed!!!\n");
+  } else {
+    printf("Passed!!!\n");
+  }
+  CS149Logger.printStats();
+  printf("[clamped exp compact]:\t[%.3f] ms\t(%.2fx speedup)\n",
+         compactTime * 1000, serialTime / compactTime);
+
+  if (sweep) {
+    printf("\n\e[1;31mCLAMPED EXPONENT WIDTH SWEEP\e[0m \n");
+    bool sweepCorrect = sweepWidth<2>(values, exponents, output, gold, N) &&
+                        sweepWidth<4>(values, exponents, output, gold, N) &&
+                        sweepWidth<8>(values, exponents, output, gold, N) &&
+                        sweepWidth<16>(values, exponents, output, gold, N) &&
+                        sweepWidth<32>(values, exponents, output, gold, N) &&
+                        sweepWidth<64>(values, exponents, output, gold, N);
+    if (!sweepCorrect) {
       printf("@@@ Failed!!!\n");
     } else {
       printf("Passed!!!\n");
     }
+  }
+
+  printf("\n\e[1;31mABSOLUTE VALUE\e[0m \n");
+  for (int i=0; i<N+PADDING; i++) {
+    output[i] = 0.f;
+    gold[i] = 0.f;
+  }
+
+  serialTime = minTime([&] { absSerial(values, gold, N); });
+  vectorTime = minTime([&] { absVector(values, output, N); });
+
+  if (!verifyResult(values, exponents, output, gold, N)) {
+    printf("@@@ Failed!!!\n");
+  } else {
+    printf("Passed!!!\n");
+  }
+  printf("[abs serial]:\t\t[%.3f] ms\n", serialTime * 1000);
+  printf("[abs vector]:\t\t[%.3f] ms\t(%.2fx speedup)\n",
+         vectorTime * 1000, serialTime / vectorTime);
+
+  printf("\n\e[1;31mARRAY SUM\e[0m (bonus) \n");
+  float sumGold = 0.f, sumOutput = 0.f;
+  serialTime = minTime([&] { sumGold = arraySumSerial(values, N); });
+  vectorTime = minTime([&] { sumOutput = arraySumVector(values, N); });
+
+  // the two sums round differently, by more as N grows
+  float epsilon = 0.1;
+  bool sumCorrect = abs(sumGold - sumOutput) < epsilon * 2 * max(1.f, abs(sumGold) * 1e-3f);
+  if (!sumCorrect) {
+    printf("Expected %f, got %f\n.", sumGold, sumOutput);
+    printf("@@@ Failed!!!\n");
   } else {
-    printf("Must have N %% VECTOR_WIDTH == 0 for this problem (VECTOR_WIDTH is %d)\n", VECTOR_WIDTH);
+    printf("Passed!!!\n");
   }
+  printf("[array sum serial]:\t[%.3f] ms\n", serialTime * 1000);
+  printf("[array sum vector]:\t[%.3f] ms\t(%.2fx speedup)\n",
+         vectorTime * 1000, serialTime / vectorTime);
 
   delete [] values;
   delete [] exponents;
@@ -107,16 +238,28 @@ void usage(const char* progname) {
   printf("Program Options:\n");
   printf("  -s  --size <N>     Use workload size N (Default = 16)\n");
   printf("  -l  --log          Print vector unit execution log\n");
+  printf("  -w  --sweep        Also run clamped exp at vector widths 2 to %d\n", MAX_SWEEP_WIDTH);
+  printf("  -p  --profile      Print clamped exp utilization per instruction and call site\n");
+  printf("  -f  --flame <FILE> Write the clamped exp call site profile to FILE in\n");
+  printf("                     folded flame graph format\n");
+  printf("  -d  --divergent    Give one lane in every VECTOR_WIDTH exponent %d and the\n", EXP_MAX - 1);
+  printf("                     others exponent 1, the worst case for clamped exp\n");
+  printf("  -c  --check        Check the CS149vecops.h library against serial loops\n");
+  printf("                     at every width and many sizes, then exit\n");
   printf("  -?  --help         This message\n");
 }
 
-void initValue(float* values, int* exponents, float* output, float* gold, unsigned int N) {
+void initValue(float* values, int* exponents, float* output, float* gold, unsigned int N,
+               bool divergent) {
 
-  for (unsigned int i=0; i<N+VECTOR_WIDTH; i++)
+  for (unsigned int i=0; i<N+PADDING; i++)
   {
     // random input values
     values[i] = -1.f + 4.f * static_cast<float>(rand()) / RAND_MAX;
     exponents[i] = rand() % EXP_MAX;
+    if (divergent) {
+      exponents[i] = (i % VECTOR_WIDTH == 0) ? EXP_MAX - 1 : 1;
+    }
     output[i] = 0.f;
     gold[i] = 0.f;
   }
@@ -126,7 +269,7 @@ void initValue(float* values, int* exponents, float* output, float* gold, unsign
 bool verifyResult(float* values, int* exponents, float* output, float* gold, int N) {
   int incorrect = -1;
   float epsilon = 0.00001;
-  for (int i=0; i<N+VECTOR_WIDTH; i++) {
+  for (int i=0; i<N+PADDING; i++) {
     if ( abs(output[i] - gold[i]) > epsilon ) {
       incorrect = i;
       break;
@@ -183,13 +326,12 @@ void absVector(float* values, float* output, int N) {
   __cs149_vec_float zero = _cs149_vset_float(0.f);
   __cs149_mask maskAll, maskIsNegative, maskIsNotNegative;
 
-//  Note: Take a careful look at this loop indexing.  This example
-//  code is not guaranteed to work when (N % VECTOR_WIDTH) != 0.
-//  Why is that the case?
+//  Note: when (N % VECTOR_WIDTH) != 0 the last iteration covers fewer
+//  than VECTOR_WIDTH elements, so only those lanes are turned on.
   for (int i=0; i<N; i+=VECTOR_WIDTH) {
 
-    // All ones
-    maskAll = _cs149_init_ones();
+    // All ones, or the first N-i lanes in the last iteration
+    maskAll = _cs149_init_ones(min(VECTOR_WIDTH, N-i));
 
     // All zeros
     maskIsNegative = _cs149_init_ones(0);
@@ -240,6 +382,7 @@ void clampedExpSerial(float* values, int* exponents, float* output, int N) {
   }
 }
 
+template <int W>
 void clampedExpVector(float* values, int* exponents, float* output, int N) {
 
   //
@@ -249,46 +392,136 @@ void clampedExpVector(float* values, int* exponents, float* output, int N) {
   // Your solution should work for any value of
   // N and VECTOR_WIDTH, not just when VECTOR_WIDTH divides N
   //
-  __cs149_mask mask_ones = _cs149_init_ones();
-  __cs149_mask mask_zeros = _cs149_mask_not(mask_ones);
-  __cs149_vec_int v_int_zeros = _cs149_vset_int(0);
-  __cs149_vec_int v_int_ones = _cs149_vset_int(1);
+  __cs149_mask_w<W> mask_ones = _cs149_init_ones<W>();
+  __cs149_mask_w<W> mask_zeros = _cs149_mask_not(mask_ones);
+  __cs149_vec<int, W> v_int_zeros = _cs149_vset_int<W>(0);
+  __cs149_vec<int, W> v_int_ones = _cs149_vset_int<W>(1);
   
-  for (int i = 0; i < N; i += VECTOR_WIDTH) {
-    // 初始化v_output
-    int offset = i;
-    if (offset + VECTOR_WIDTH > N) {
-      // 中间有一部分数据重叠，二次计算
-      offset = N - VECTOR_WIDTH;
-    }
-    __cs149_vec_float v_values;
-    _cs149_vload_float(v_values, values + offset, mask_ones);
-    __cs149_vec_float v_output = _cs149_vset_float(1);
-    __cs149_vec_int v_exponents;
-    _cs149_vload_int(v_exponents, exponents + offset, mask_ones);
+  for (int i = 0; i < N; i += W) {
+    // 最后一次迭代只打开前 N-i 个 lane
+    __cs149_mask_w<W> mask_valid = _cs149_init_ones<W>(min(W, N - i));
+    __cs149_vec<float, W> v_values;
+    _cs149_vload_float(v_values, values + i, mask_valid);
+    __cs149_vec<float, W> v_output = _cs149_vset_float<W>(1);
+    __cs149_vec<int, W> v_exponents;
+    _cs149_vload_int(v_exponents, exponents + i, mask_valid);
     
     // 初始化mask
-    __cs149_mask mask_operation;
-    _cs149_veq_int(mask_operation, v_exponents, v_int_zeros, mask_ones);
-    mask_operation = _cs149_mask_not(mask_operation);
+    __cs149_mask_w<W> mask_operation = mask_zeros;
+    _cs149_vgt_int(mask_operation, v_exponents, v_int_zeros, mask_valid);
     
     // 循环乘
     while (_cs149_cntbits(mask_operation)) {
       _cs149_vmult_float(v_output, v_output, v_values, mask_operation);
       _cs149_vsub_int(v_exponents, v_exponents, v_int_ones, mask_operation);
-      _cs149_veq_int(mask_operation, v_exponents, v_int_zeros, mask_ones);
-      mask_operation = _cs149_mask_not(mask_operation);
+      _cs149_vgt_int(mask_operation, v_exponents, v_int_zeros, mask_operation);
     }
     // clamp value to 9.999
-    __cs149_vec_float v_clamp = _cs149_vset_float(9.999999f);
-    __cs149_mask is_clamp;
-    _cs149_vgt_float(is_clamp, v_output, v_clamp, mask_ones);
+    __cs149_vec<float, W> v_clamp = _cs149_vset_float<W>(9.999999f);
+    __cs149_mask_w<W> is_clamp = mask_zeros;
+    _cs149_vgt_float(is_clamp, v_output, v_clamp, mask_valid);
     _cs149_vmove_float(v_output, v_clamp, is_clamp);
     // construct output
-    _cs149_vstore_float(output + offset, v_output, mask_ones);
+    _cs149_vstore_float(output + i, v_output, mask_valid);
   }
 }
 
+// Same result as clampedExpVector, but lanes do not wait for the slowest
+// lane of their vector: once lanes have used up their exponent, their
+// results are scattered to output and they are refilled with the next
+// input elements, so the multiply loop stays mostly full until the input
+// runs out.  Refills cost extra instructions, so this pays off when
+// exponents within a vector differ a lot (try --divergent).
+template <int W>
+void clampedExpCompactVector(float* values, int* exponents, float* output, int N) {
+  __cs149_mask_w<W> mask_zeros = _cs149_init_ones<W>(0);
+  __cs149_vec<int, W> v_int_zeros = _cs149_vset_int<W>(0);
+  __cs149_vec<int, W> v_int_ones = _cs149_vset_int<W>(1);
+  __cs149_vec<int, W> v_n = _cs149_vset_int<W>(N);
+  __cs149_vec<float, W> v_clamp = _cs149_vset_float<W>(9.999999f);
+
+  int laneIds[W];
+  for (int i=0; i<W; i++) laneIds[i] = i;
+  __cs149_mask_w<W> mask_ones = _cs149_init_ones<W>();
+  __cs149_vec<int, W> v_lane;
+  _cs149_vload_int(v_lane, laneIds, mask_ones);
+
+  // per lane: the element it holds, its base, the product so far and the
+  // multiplies left
+  __cs149_vec<int, W> v_index = _cs149_vset_int<W>(0);
+  __cs149_vec<float, W> v_values = _cs149_vset_float<W>(0.f);
+  __cs149_vec<float, W> v_output = _cs149_vset_float<W>(1.f);
+  __cs149_vec<int, W> v_exponents = _cs149_vset_int<W>(0);
+  // lanes holding an element, and those of them still multiplying
+  __cs149_mask_w<W> mask_live = mask_zeros;
+  __cs149_mask_w<W> mask_busy = mask_zeros;
+
+  int next = 0;
+  int freeLanes[W];
+  int refill[W];
+  while (true) {
+    // a refill costs about as much as five multiply steps, so wait until
+    // half the lanes are idle before paying for one
+    int idle = W - _cs149_cntbits(mask_busy);
+    if (2 * idle >= W || next >= N) {
+      __cs149_mask_w<W> mask_free = _cs149_mask_not(mask_busy);
+
+      // retire finished lanes
+      __cs149_mask_w<W> mask_done = _cs149_mask_and(mask_live, mask_free);
+      if (_cs149_cntbits(mask_done)) {
+        __cs149_mask_w<W> is_clamp = mask_zeros;
+        _cs149_vgt_float(is_clamp, v_output, v_clamp, mask_done);
+        _cs149_vmove_float(v_output, v_clamp, is_clamp);
+        _cs149_vscatter_float(output, v_index, v_output, mask_done);
+      }
+
+      // the k free lanes take elements next .. next+k-1, in lane order
+      mask_live = mask_busy;
+      if (next < N) {
+        int k = _cs149_vcompress_int(freeLanes, v_lane, mask_free);
+        __cs149_mask_w<W> mask_first = _cs149_init_ones<W>(k);
+        __cs149_vec<int, W> v_slot, v_next;
+        __cs149_vec<int, W> v_base = _cs149_vset_int<W>(next);
+        _cs149_vload_int(v_slot, freeLanes, mask_first);
+        _cs149_vadd_int(v_next, v_lane, v_base, mask_first);
+        _cs149_vscatter_int(refill, v_slot, v_next, mask_first);
+        _cs149_vload_int(v_index, refill, mask_free);
+        next += k;
+
+        __cs149_mask_w<W> mask_new = mask_zeros;
+        __cs149_mask_w<W> mask_start = mask_zeros;
+        _cs149_vlt_int(mask_new, v_index, v_n, mask_free);
+        _cs149_vgather_float(v_values, values, v_index, mask_new);
+        _cs149_vgather_int(v_exponents, exponents, v_index, mask_new);
+        _cs149_vset_float(v_output, 1.f, mask_new);
+        _cs149_vgt_int(mask_start, v_exponents, v_int_zeros, mask_new);
+        mask_live = _cs149_mask_or(mask_live, mask_new);
+        mask_busy = _cs149_mask_or(mask_busy, mask_start);
+      }
+    }
+    if (!_cs149_cntbits(mask_live)) break;
+
+    _cs149_vmult_float(v_output, v_output, v_values, mask_busy);
+    _cs149_vsub_int(v_exponents, v_exponents, v_int_ones, mask_busy);
+    _cs149_vgt_int(mask_busy, v_exponents, v_int_zeros, mask_busy);
+  }
+}
+
+// Runs clampedExpVector with W-wide vectors and reports the lane
+// utilization and time; gold must hold the clampedExpSerial result.
+template <int W>
+bool sweepWidth(float* values, int* exponents, float* output, float* gold, int N) {
+  for (int i=0; i<N+PADDING; i++) {
+    output[i] = 0.f;
+  }
+  double vectorTime = minTime([&] { clampedExpVector<W>(values, exponents, output, N); }, W);
+
+  bool correct = verifyResult(values, exponents, output, gold, N);
+  CS149Logger.printStats();
+  printf("[clamped exp vector, width %d]:\t[%.3f] ms\n", W, vectorTime * 1000);
+  return correct;
+}
+
 // returns the sum of all elements in values
 float arraySumSerial(float* values, int N) {
   float sum = 0;
@@ -299,19 +532,79 @@ float arraySumSerial(float* values, int N) {
   return sum;
 }
 
-// returns the sum of all elements in values
-// You can assume N is a multiple of VECTOR_WIDTH
-// You can assume VECTOR_WIDTH is a power of 2
+// returns the sum of all elements in values: VECTOR_WIDTH running sums,
+// then a log2(VECTOR_WIDTH) tree across the lanes
 float arraySumVector(float* values, int N) {
-  
-  //
-  // CS149 STUDENTS TODO: Implement your vectorized version of arraySumSerial here
-  //
-  
-  for (int i=0; i<N; i+=VECTOR_WIDTH) {
+  return reduceAddVector<VECTOR_WIDTH>(values, N);
+}
 
-  }
+// Compares every CS149vecops.h operation at width W with a serial loop,
+// for N = 0 to 4W+1 and a few larger N.  Sums are checked to a tolerance
+// relative to the sum of absolute values, everything else exactly.
+template <int W>
+bool checkVecops() {
+  vector<int> sizes;
+  for (int n=0; n<=4*W+1; n++) sizes.push_back(n);
+  sizes.push_back(1000);
+  sizes.push_back(4099);
+
+  for (size_t s=0; s<sizes.size(); s++) {
+    int N = sizes[s];
+    vector<float> values(N+PADDING), output(N+PADDING), gold(N+PADDING);
+    vector<int> index(N+PADDING, 0);
+    for (int i=0; i<N; i++) {
+      values[i] = -1.f + 4.f * static_cast<float>(rand()) / RAND_MAX;
+      index[i] = rand() % N;
+    }
+    const char* failed = NULL;
+
+    double sum = 0., absSum = 0.;
+    float minimum = INFINITY, maximum = -INFINITY;
+    for (int i=0; i<N; i++) {
+      sum += values[i];
+      absSum += fabs(values[i]);
+      minimum = min(minimum, values[i]);
+      maximum = max(maximum, values[i]);
+    }
+    double tolerance = 1e-5 * absSum + 1e-6;
+    if (fabs(reduceAddVector<W>(values.data(), N) - sum) > tolerance) failed = "reduceAdd";
+    if (reduceMinVector<W>(values.data(), N) != minimum) failed = "reduceMin";
+    if (reduceMaxVector<W>(values.data(), N) != maximum) failed = "reduceMax";
 
-  return 0.0;
+    exclusiveScanVector<W>(values.data(), output.data(), N);
+    double prefix = 0.;
+    for (int i=0; i<N; i++) {
+      if (fabs(output[i] - prefix) > tolerance) failed = "exclusiveScan";
+      prefix += values[i];
+    }
+
+    gatherVector<W>(values.data(), index.data(), output.data(), N);
+    for (int i=0; i<N; i++) {
+      if (output[i] != values[index[i]]) failed = "gather";
+    }
+
+    fill(output.begin(), output.end(), 0.f);
+    fill(gold.begin(), gold.end(), 0.f);
+    scatterVector<W>(values.data(), index.data(), output.data(), N);
+    for (int i=0; i<N; i++) {
+      gold[index[i]] = values[i];
+    }
+    if (output != gold) failed = "scatter";
+
+    int count = compressGreaterVector<W>(values.data(), 1.f, output.data(), N);
+    int goldCount = 0;
+    for (int i=0; i<N; i++) {
+      if (values[i] > 1.f) gold[goldCount++] = values[i];
+    }
+    if (count != goldCount || !equal(gold.begin(), gold.begin() + count, output.begin()))
+      failed = "compressGreater";
+
+    if (failed) {
+      printf("%s is wrong for width %d and N = %d\n", failed, W, N);
+      return false;
+    }
+  }
+  printf("Results matched for width %d\n", W);
+  return true;
 }
 
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <math.h>
 #include <algorithm>
+#include <thread>
 #include <getopt.h>
 
 #include "CycleTimer.h"
@@ -12,6 +14,32 @@ extern void mandelbrotSerial(
     int maxIterations,
     int output[]);
 
+extern void mandelbrotSerialPruned(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
+extern void mandelbrotSimd(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int numRows,
+    int maxIterations,
+    int output[]);
+
+extern const char* mandelbrotSimdISA();
+
+extern int mandelbrotReferenceOrbit(
+    double cx_hi, double cx_lo, double cy_hi, double cy_lo,
+    int maxIterations,
+    double orbit_re[], double orbit_im[]);
+
+extern int mandelDeep(
+    double cx_hi, double cx_lo, double cy_hi, double cy_lo,
+    double offset_re, double offset_im,
+    int maxIterations);
+
 extern void mandelbrotThread(
     int numThreads,
     float x0, float y0, float x1, float y1,
@@ -19,6 +47,8 @@ extern void mandelbrotThread(
     int maxIterations,
     int output[]);
 
+extern "C" void ISPCInitTaskSystem();
+
 extern void writePPMImage(
     int* data,
     int width, int height,
@@ -60,10 +90,254 @@ scaleAndShift(float& x0, float& x1, float& y0, float& y1,
 
 using namespace ispc;
 
+//
+// Zoom sequence: ZOOM_FRAMES frames, each zoomed 2x about the same
+// center.  Floats run out of precision after ~14 halvings, so the zoom
+// restarts every ZOOM_DEPTH frames.
+//
+static const int ZOOM_FRAMES = 100;
+static const int ZOOM_DEPTH = 12;
+// coarsest pass of the progressive render of a frame from scratch
+static const int ZOOM_PREVIEW_STRIDE = 8;
+
+//
+// Copies into frame every pixel whose offsets from the center are both
+// even from prevFrame, which was rendered with twice the pixel spacing
+// (see mandelbrot_ispc_zoom).
+//
+static void reuseZoomedFrame(const int* prevFrame, int* frame, int width, int height)
+{
+    int cx = width / 2;
+    int cy = height / 2;
+
+    for (int j = cy & 1; j < height; j += 2) {
+        const int* src = prevFrame + (cy + (j - cy) / 2) * width + cx;
+        int* dst = frame + j * width;
+        for (int i = cx & 1; i < width; i += 2)
+            dst[i] = src[(i - cx) / 2];
+    }
+}
+
+//
+// Renders the zoom sequence twice, computing every pixel of every frame
+// and reusing the previous frame plus progressive refinement, checks
+// that both give the same frames and reports frames/sec.
+//
+static bool runZoomSequence(int width, int height, int maxIterations)
+{
+    const float cx = -0.743643887f;
+    const float cy = 0.131825904f;
+    const float d0 = 3.f / width;
+
+    int* frame = new int[width * height];
+    int* prevFrame = new int[width * height];
+    int* gold = new int[width * height];
+
+    double fullTime = 0.0;
+    double reuseTime = 0.0;
+    double previewTime = 0.0;
+    double firstPreviewTime = 0.0;
+    bool ok = true;
+
+    for (int f = 0; f < ZOOM_FRAMES && ok; f++) {
+        float d = ldexpf(d0, -(f % ZOOM_DEPTH));
+
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrot_ispc_zoom(cx, cy, d, width, height, 1, false, maxIterations, gold);
+        fullTime += CycleTimer::currentSeconds() - startTime;
+
+        startTime = CycleTimer::currentSeconds();
+        int stride;
+        if (f % ZOOM_DEPTH == 0) {
+            // nothing to reuse: coarse-to-fine passes, each filling in the
+            // pixels between those of the previous one
+            stride = ZOOM_PREVIEW_STRIDE;
+            mandelbrot_ispc_zoom(cx, cy, d, width, height, stride, false, maxIterations, frame);
+        } else {
+            // the previous frame is this frame at half resolution
+            stride = 2;
+            reuseZoomedFrame(prevFrame, frame, width, height);
+        }
+        double preview = CycleTimer::currentSeconds() - startTime;
+        previewTime += preview;
+        if (f == 0)
+            firstPreviewTime = preview;
+
+        for (stride /= 2; stride >= 1; stride /= 2)
+            mandelbrot_ispc_zoom(cx, cy, d, width, height, stride, true, maxIterations, frame);
+        reuseTime += CycleTimer::currentSeconds() - startTime;
+
+        if (! verifyResult (gold, frame, width, height)) {
+            printf ("Error : Zoom frame %d differs from full recompute\n", f);
+            ok = false;
+        }
+
+        std::swap(frame, prevFrame);
+    }
+
+    if (ok) {
+        printf("[zoom full recompute]:\t\t[%.1f] fps\n", ZOOM_FRAMES / fullTime);
+        printf("[zoom with reuse]:\t\t[%.1f] fps\n", ZOOM_FRAMES / reuseTime);
+        printf("\t\t\t\t(preview after [%.3f] ms on average, [%.3f] ms for frame 0)\n",
+               previewTime / ZOOM_FRAMES * 1000, firstPreviewTime * 1000);
+        printf("\t\t\t\t(%.2fx speedup from reuse over %d frames)\n",
+               fullTime / reuseTime, ZOOM_FRAMES);
+        writePPMImage(prevFrame, width, height, "mandelbrot-zoom.ppm", maxIterations);
+    }
+
+    delete[] frame;
+    delete[] prevFrame;
+    delete[] gold;
+
+    return ok;
+}
+
+//
+// Deep zoom: the view is 3 * 10^-exponent wide around a point in the
+// seahorse valley, given to double-double precision as hi + lo.
+//
+static const double DEEP_CX_HI = -0.7436438870371587;
+static const double DEEP_CX_LO = -3.628952515063387e-17;
+static const double DEEP_CY_HI = 0.13182590420531198;
+static const double DEEP_CY_LO = -1.2892807754956675e-17;
+// deeper views need longer orbits before anything escapes
+static int deepMaxIterations(int exponent)
+{
+    return 512 * (exponent + 2);
+}
+// every DEEP_CHECK_STRIDE'th pixel in each direction is checked against
+// a double-double computation
+static const int DEEP_CHECK_STRIDE = 16;
+
+static long sumIterations(const int* output, int width, int height)
+{
+    long total = 0;
+    for (int i = 0; i < width * height; i++)
+        total += output[i];
+    return total;
+}
+
+// Percentage of the sampled pixels of output that match the double-double
+// computation in gold (filled on first use).
+static double deepAgreement(const int* output, int* gold, double d,
+                            int width, int height, int maxIterations)
+{
+    int samples = 0, matches = 0;
+    for (int j = 0; j < height; j += DEEP_CHECK_STRIDE) {
+        for (int i = 0; i < width; i += DEEP_CHECK_STRIDE) {
+            int index = j * width + i;
+            if (gold[index] < 0)
+                gold[index] = mandelDeep(DEEP_CX_HI, DEEP_CX_LO, DEEP_CY_HI, DEEP_CY_LO,
+                                         (i - width / 2) * d, (j - height / 2) * d,
+                                         maxIterations);
+            samples++;
+            if (output[index] == gold[index])
+                matches++;
+        }
+    }
+    return 100.0 * matches / samples;
+}
+
+//
+// Renders the deep-zoom view with the float, double and perturbation
+// kernels, reporting time, throughput in iterations/sec and how many
+// sampled pixels agree with a double-double computation.
+//
+static void runDeepZoom(int width, int height, int exponent, int numTasks)
+{
+    const double d = 3.0 * pow(10.0, -exponent) / width;
+    const int maxIterations = deepMaxIterations(exponent);
+
+    int* output = new int[width * height];
+    int* gold = new int[width * height];
+    double* orbit_re = new double[maxIterations + 2];
+    double* orbit_im = new double[maxIterations + 2];
+
+    for (int i = 0; i < width * height; ++i)
+        gold[i] = -1;
+
+    printf("[deep zoom]:\t\t\t10^-%d view, %d iterations\n", exponent, maxIterations);
+
+    //
+    // float, for reference throughput (pixelates past ~10^-5)
+    //
+    double minFloat = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrot_ispc_zoom((float)DEEP_CX_HI, (float)DEEP_CY_HI, (float)d,
+                             width, height, 1, false, maxIterations, output);
+        double endTime = CycleTimer::currentSeconds();
+        minFloat = std::min(minFloat, endTime - startTime);
+    }
+    double floatRate = sumIterations(output, width, height) / minFloat;
+    printf("[deep float ispc]:\t\t[%.3f] ms\t[%.2f] Giter/s\t(%.1f%% match)\n",
+           minFloat * 1000, floatRate * 1e-9,
+           deepAgreement(output, gold, d, width, height, maxIterations));
+
+    //
+    // double (pixelates past ~10^-12)
+    //
+    double minDouble = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrot_ispc_double(DEEP_CX_HI, DEEP_CY_HI, d, width, height,
+                               numTasks, maxIterations, output);
+        double endTime = CycleTimer::currentSeconds();
+        minDouble = std::min(minDouble, endTime - startTime);
+    }
+    double doubleRate = sumIterations(output, width, height) / minDouble;
+    printf("[deep double ispc]:\t\t[%.3f] ms\t[%.2f] Giter/s\t(%.1f%% match)\n",
+           minDouble * 1000, doubleRate * 1e-9,
+           deepAgreement(output, gold, d, width, height, maxIterations));
+
+    //
+    // perturbation against the center's orbit; the orbit is recomputed
+    // each time since it is part of rendering a new view
+    //
+    double minPerturbed = 1e30;
+    int refLength = 0;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        refLength = mandelbrotReferenceOrbit(DEEP_CX_HI, DEEP_CX_LO, DEEP_CY_HI, DEEP_CY_LO,
+                                             maxIterations, orbit_re, orbit_im);
+        mandelbrot_ispc_perturbed(d, width, height, numTasks, maxIterations,
+                                  orbit_re, orbit_im, refLength, output);
+        double endTime = CycleTimer::currentSeconds();
+        minPerturbed = std::min(minPerturbed, endTime - startTime);
+    }
+    double perturbedRate = sumIterations(output, width, height) / minPerturbed;
+    printf("[deep perturbation ispc]:\t[%.3f] ms\t[%.2f] Giter/s\t(%.1f%% match)\n",
+           minPerturbed * 1000, perturbedRate * 1e-9,
+           deepAgreement(output, gold, d, width, height, maxIterations));
+    printf("\t\t\t\t(reference orbit of %d points; perturbation at %.2fx\n"
+           "\t\t\t\t the float throughput, double at %.2fx)\n",
+           refLength, perturbedRate / floatRate, doubleRate / floatRate);
+
+    writePPMImage(output, width, height, "mandelbrot-deep.ppm", maxIterations);
+
+    delete[] output;
+    delete[] gold;
+    delete[] orbit_re;
+    delete[] orbit_im;
+}
+
 void usage(const char* progname) {
     printf("Usage: %s [options]\n", progname);
     printf("Program Options:\n");
     printf("  -t  --tasks        Run ISPC code implementation with tasks\n");
+    printf("  -c  --task-count <N> Number of row-band tasks for --tasks (default 8 per\n");
+    printf("                     hardware thread)\n");
+    printf("  -w  --sweep        Time task counts and 2D tile sizes, report the best\n");
+    printf("  -s  --span <N>     Also run ISPC tasks of N pixels each (N=1 launches\n");
+    printf("                     one task per pixel, 960,000 tasks at 1200x800)\n");
+    printf("  -m  --many-tasks <N>  Also run the image as exactly N ISPC tasks; past\n");
+    printf("                     960,000, some have no pixels (e.g. 1048576 for 1M)\n");
+    printf("  -n  --nested <N>   Also run ISPC with N band tasks that each launch\n");
+    printf("                     one subtask per row\n");
+    printf("  -z  --zoom         Also render a %d-frame zoom sequence with and without\n", ZOOM_FRAMES);
+    printf("                     reuse of the previous frame\n");
+    printf("  -d  --deep <E>     Also render a deep zoom 3*10^-E wide with the float,\n");
+    printf("                     double and perturbation kernels\n");
     printf("  -v  --view <INT>   Use specified view settings\n");
     printf("  -?  --help         This message\n");
 }
@@ -81,22 +355,77 @@ int main(int argc, char** argv) {
     float y1 = 1;
 
     bool useTasks = false;
+    int span = 0;
+    int manyTasks = 0;
+    int numBands = 0;
+    bool zoom = false;
+    int numTasks = 8 * std::max(1u, std::thread::hardware_concurrency());
+    bool sweep = false;
+    int deepExponent = -1;
 
     // parse commandline options ////////////////////////////////////////////
     int opt;
     static struct option long_options[] = {
         {"tasks", 0, 0, 't'},
+        {"span",  1, 0, 's'},
+        {"many-tasks", 1, 0, 'm'},
+        {"nested", 1, 0, 'n'},
+        {"zoom",  0, 0, 'z'},
+        {"task-count", 1, 0, 'c'},
+        {"sweep", 0, 0, 'w'},
+        {"deep",  1, 0, 'd'},
         {"view",  1, 0, 'v'},
         {"help",  0, 0, '?'},
         {0 ,0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "tv:?", long_options, NULL)) != EOF) {
+    while ((opt = getopt_long(argc, argv, "tc:ws:m:n:zd:v:?", long_options, NULL)) != EOF) {
 
         switch (opt) {
         case 't':
             useTasks = true;
             break;
+        case 's':
+            span = atoi(optarg);
+            if (span <= 0) {
+                fprintf(stderr, "Span must be at least 1 pixel\n");
+                return 1;
+            }
+            break;
+        case 'm':
+            manyTasks = atoi(optarg);
+            if (manyTasks <= 0) {
+                fprintf(stderr, "Need at least 1 task\n");
+                return 1;
+            }
+            break;
+        case 'n':
+            numBands = atoi(optarg);
+            if (numBands <= 0) {
+                fprintf(stderr, "Need at least 1 band\n");
+                return 1;
+            }
+            break;
+        case 'z':
+            zoom = true;
+            break;
+        case 'c':
+            numTasks = atoi(optarg);
+            if (numTasks <= 0) {
+                fprintf(stderr, "Need at least 1 task\n");
+                return 1;
+            }
+            break;
+        case 'w':
+            sweep = true;
+            break;
+        case 'd':
+            deepExponent = atoi(optarg);
+            if (deepExponent < 0 || deepExponent > 28) {
+                fprintf(stderr, "Deep zoom exponent must be between 0 and 28\n");
+                return 1;
+            }
+            break;
         case 'v':
         {
             int viewIndex = atoi(optarg);
@@ -120,6 +449,9 @@ int main(int argc, char** argv) {
     }
     // end parsing of commandline options
 
+    // start the task system's worker threads before anything is timed
+    ISPCInitTaskSystem();
+
     int *output_serial = new int[width*height];
     int *output_ispc = new int[width*height];
     int *output_ispc_tasks = new int[width*height];
@@ -171,6 +503,81 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    //
+    // Hand-written intrinsics kernel, for comparison with ISPC's code
+    //
+    for (unsigned int i = 0; i < width * height; ++i)
+        output_ispc[i] = 0;
+
+    double minSimd = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrotSimd(x0, y0, x1, y1, width, height, 0, height, maxIterations, output_ispc);
+        double endTime = CycleTimer::currentSeconds();
+        minSimd = std::min(minSimd, endTime - startTime);
+    }
+
+    printf("[mandelbrot simd %s]:\t[%.3f] ms\n", mandelbrotSimdISA(), minSimd * 1000);
+
+    if (! verifyResult (output_serial, output_ispc, width, height)) {
+        printf ("Error : SIMD output differs from sequential output\n");
+
+        delete[] output_serial;
+        delete[] output_ispc;
+        delete[] output_ispc_tasks;
+
+        return 1;
+    }
+
+    //
+    // Serial and ISPC kernels with cardioid/bulb and cycle rejection
+    //
+    for (unsigned int i = 0; i < width * height; ++i)
+        output_ispc[i] = 0;
+
+    double minSerialPruned = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrotSerialPruned(x0, y0, x1, y1, width, height, 0, height, maxIterations, output_ispc);
+        double endTime = CycleTimer::currentSeconds();
+        minSerialPruned = std::min(minSerialPruned, endTime - startTime);
+    }
+
+    printf("[mandelbrot serial pruned]:\t[%.3f] ms\n", minSerialPruned * 1000);
+
+    if (! verifyResult (output_serial, output_ispc, width, height)) {
+        printf ("Error : Pruned serial output differs from sequential output\n");
+
+        delete[] output_serial;
+        delete[] output_ispc;
+        delete[] output_ispc_tasks;
+
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < width * height; ++i)
+        output_ispc[i] = 0;
+
+    double minPrunedISPC = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        mandelbrot_ispc_pruned(x0, y0, x1, y1, width, height, maxIterations, output_ispc);
+        double endTime = CycleTimer::currentSeconds();
+        minPrunedISPC = std::min(minPrunedISPC, endTime - startTime);
+    }
+
+    printf("[mandelbrot ispc pruned]:\t[%.3f] ms\n", minPrunedISPC * 1000);
+
+    if (! verifyResult (output_serial, output_ispc, width, height)) {
+        printf ("Error : Pruned ISPC output differs from sequential output\n");
+
+        delete[] output_serial;
+        delete[] output_ispc;
+        delete[] output_ispc_tasks;
+
+        return 1;
+    }
+
     // Clear out the buffer
     for (unsigned int i = 0; i < width * height; ++i) {
         output_ispc_tasks[i] = 0;
@@ -183,23 +590,190 @@ int main(int argc, char** argv) {
         //
         for (int i = 0; i < 3; ++i) {
             double startTime = CycleTimer::currentSeconds();
-            mandelbrot_ispc_withtasks(x0, y0, x1, y1, width, height, maxIterations, output_ispc_tasks);
+            mandelbrot_ispc_withtasks(x0, y0, x1, y1, width, height, numTasks, maxIterations, output_ispc_tasks);
             double endTime = CycleTimer::currentSeconds();
             minTaskISPC = std::min(minTaskISPC, endTime - startTime);
         }
 
-        printf("[mandelbrot multicore ispc]:\t[%.3f] ms\n", minTaskISPC * 1000);
+        printf("[mandelbrot %d-task ispc]:\t[%.3f] ms\n", numTasks, minTaskISPC * 1000);
         writePPMImage(output_ispc_tasks, width, height, "mandelbrot-task-ispc.ppm", maxIterations);
 
         if (! verifyResult (output_serial, output_ispc_tasks, width, height)) {
             printf ("Error : ISPC output differs from sequential output\n");
             return 1;
         }
+
+        //
+        // Overhead of launch + sync alone, with two tasks that do no
+        // work
+        //
+        const int numLaunches = 10000;
+        CycleTimer::SysClock startTicks = CycleTimer::currentTicks();
+        for (int i = 0; i < numLaunches; ++i)
+            launch_empty_tasks(2);
+        CycleTimer::SysClock endTicks = CycleTimer::currentTicks();
+
+        printf("[empty 2-task launch]:\t\t[%.0f] %s\n",
+               (double)(endTicks - startTicks) / numLaunches, CycleTimer::tickUnits());
+    }
+
+    if (sweep) {
+        //
+        // Row bands: powers of two up to one task per row
+        //
+        double bestTime = 1e30;
+        char bestConfig[64] = "";
+
+        for (int tasks = 1; ; tasks = std::min(2 * tasks, (int)height)) {
+            double minTime = 1e30;
+            for (int i = 0; i < 3; ++i) {
+                double startTime = CycleTimer::currentSeconds();
+                mandelbrot_ispc_withtasks(x0, y0, x1, y1, width, height, tasks, maxIterations, output_ispc_tasks);
+                double endTime = CycleTimer::currentSeconds();
+                minTime = std::min(minTime, endTime - startTime);
+            }
+            if (! verifyResult (output_serial, output_ispc_tasks, width, height)) {
+                printf ("Error : ISPC output differs from sequential output\n");
+                return 1;
+            }
+
+            printf("[sweep %4d row tasks]:\t\t[%.3f] ms\n", tasks, minTime * 1000);
+            if (minTime < bestTime) {
+                bestTime = minTime;
+                snprintf(bestConfig, sizeof(bestConfig), "%d row tasks", tasks);
+            }
+            if (tasks == (int)height)
+                break;
+        }
+
+        //
+        // 2D tiles, from fits-in-L1 to fits-in-L2 output footprints
+        //
+        static const int tileSizes[][2] = {
+            { 16, 16 }, { 32, 32 }, { 64, 16 }, { 64, 64 },
+            { 128, 32 }, { 128, 128 }, { 256, 64 },
+        };
+        for (const auto& tile : tileSizes) {
+            double minTime = 1e30;
+            for (int i = 0; i < 3; ++i) {
+                double startTime = CycleTimer::currentSeconds();
+                mandelbrot_ispc_withtiles(x0, y0, x1, y1, width, height, tile[0], tile[1], maxIterations, output_ispc_tasks);
+                double endTime = CycleTimer::currentSeconds();
+                minTime = std::min(minTime, endTime - startTime);
+            }
+            if (! verifyResult (output_serial, output_ispc_tasks, width, height)) {
+                printf ("Error : ISPC output differs from sequential output\n");
+                return 1;
+            }
+
+            printf("[sweep %3dx%-3d tiles]:\t\t[%.3f] ms\n", tile[0], tile[1], minTime * 1000);
+            if (minTime < bestTime) {
+                bestTime = minTime;
+                snprintf(bestConfig, sizeof(bestConfig), "%dx%d tiles", tile[0], tile[1]);
+            }
+        }
+
+        printf("\t\t\t\t(best: %s, [%.3f] ms, %.2fx speedup)\n",
+               bestConfig, bestTime * 1000, minSerial / bestTime);
+    }
+
+    double minSpanISPC = 1e30;
+    if (span > 0) {
+        //
+        // Same computation split into (width * height) / span tasks
+        //
+        int numTasks = (width * height + span - 1) / span;
+        for (int i = 0; i < 3; ++i) {
+            for (unsigned int j = 0; j < width * height; ++j)
+                output_ispc_tasks[j] = 0;
+
+            double startTime = CycleTimer::currentSeconds();
+            mandelbrot_ispc_withspans(x0, y0, x1, y1, width, height, span, maxIterations, output_ispc_tasks);
+            double endTime = CycleTimer::currentSeconds();
+            minSpanISPC = std::min(minSpanISPC, endTime - startTime);
+        }
+
+        printf("[mandelbrot %d-task ispc]:\t[%.3f] ms\n", numTasks, minSpanISPC * 1000);
+
+        if (! verifyResult (output_serial, output_ispc_tasks, width, height)) {
+            printf ("Error : ISPC output differs from sequential output\n");
+            return 1;
+        }
+    }
+
+    double minManyISPC = 1e30;
+    if (manyTasks > 0) {
+        //
+        // Exactly manyTasks tasks, however many pixels that leaves each
+        //
+        for (int i = 0; i < 3; ++i) {
+            for (unsigned int j = 0; j < width * height; ++j)
+                output_ispc_tasks[j] = 0;
+
+            double startTime = CycleTimer::currentSeconds();
+            mandelbrot_ispc_withtaskcount(x0, y0, x1, y1, width, height, manyTasks, maxIterations, output_ispc_tasks);
+            double endTime = CycleTimer::currentSeconds();
+            minManyISPC = std::min(minManyISPC, endTime - startTime);
+        }
+
+        printf("[mandelbrot %d-task ispc]:\t[%.3f] ms\n", manyTasks, minManyISPC * 1000);
+
+        if (! verifyResult (output_serial, output_ispc_tasks, width, height)) {
+            printf ("Error : ISPC output differs from sequential output\n");
+            return 1;
+        }
+    }
+
+    double minNestedISPC = 1e30;
+    if (numBands > 0) {
+        //
+        // Nested tasks: bands of rows, each launching a task per row
+        //
+        for (int i = 0; i < 3; ++i) {
+            for (unsigned int j = 0; j < width * height; ++j)
+                output_ispc_tasks[j] = 0;
+
+            double startTime = CycleTimer::currentSeconds();
+            mandelbrot_ispc_nested(x0, y0, x1, y1, width, height, numBands, maxIterations, output_ispc_tasks);
+            double endTime = CycleTimer::currentSeconds();
+            minNestedISPC = std::min(minNestedISPC, endTime - startTime);
+        }
+
+        printf("[mandelbrot nested ispc]:\t[%.3f] ms\n", minNestedISPC * 1000);
+
+        if (! verifyResult (output_serial, output_ispc_tasks, width, height)) {
+            printf ("Error : ISPC output differs from sequential output\n");
+            return 1;
+        }
     }
 
     printf("\t\t\t\t(%.2fx speedup from ISPC)\n", minSerial/minISPC);
+    printf("\t\t\t\t(%.2fx speedup from SIMD intrinsics, %.2fx of ISPC)\n",
+           minSerial/minSimd, minISPC/minSimd);
+    printf("\t\t\t\t(%.2fx speedup from pruning serial, %.2fx from pruning ISPC)\n",
+           minSerial/minSerialPruned, minISPC/minPrunedISPC);
     if (useTasks) {
-        printf("\t\t\t\t(%.2fx speedup from task ISPC)\n", minSerial/minTaskISPC);
+        printf("\t\t\t\t(%.2fx speedup from %d-task ISPC)\n", minSerial/minTaskISPC, numTasks);
+    }
+    if (span > 0) {
+        printf("\t\t\t\t(%.2fx speedup from %d-pixel task ISPC)\n", minSerial/minSpanISPC, span);
+    }
+    if (manyTasks > 0) {
+        printf("\t\t\t\t(%.2fx speedup from %d-task ISPC)\n", minSerial/minManyISPC, manyTasks);
+    }
+    if (numBands > 0) {
+        printf("\t\t\t\t(%.2fx speedup from nested task ISPC)\n", minSerial/minNestedISPC);
+    }
+
+    if (deepExponent >= 0)
+        runDeepZoom(width, height, deepExponent, numTasks);
+
+    if (zoom && !runZoomSequence(width, height, maxIterations)) {
+        delete[] output_serial;
+        delete[] output_ispc;
+        delete[] output_ispc_tasks;
+
+        return 1;
     }
 
     delete[] output_serial;
@@ -0,0 +1,138 @@
+//
+// Higher-precision pieces of the deep-zoom mode: the reference orbit for
+// mandelbrot_ispc_perturbed, and a per-pixel check that is slow but
+// accurate at any zoom the perturbation kernel handles.
+//
+// Both use double-double numbers (value = hi + lo, about 106 bits of
+// mantissa), built from Dekker's error-free sum and product, so they need
+// neither FMA nor an arbitrary precision library.  They do rely on every
+// product being rounded on its own, so contraction into FMAs is disabled.
+//
+
+#pragma GCC optimize("fp-contract=off")
+
+struct DoubleDouble {
+    double hi, lo;
+};
+
+static inline DoubleDouble ddFromDouble(double x)
+{
+    DoubleDouble r = { x, 0.0 };
+    return r;
+}
+
+// exact a + b as an unevaluated sum
+static inline DoubleDouble twoSum(double a, double b)
+{
+    double s = a + b;
+    double bb = s - a;
+    DoubleDouble r = { s, (a - (s - bb)) + (b - bb) };
+    return r;
+}
+
+static inline DoubleDouble quickTwoSum(double a, double b)
+{
+    double s = a + b;
+    DoubleDouble r = { s, b - (s - a) };
+    return r;
+}
+
+// exact a * b as an unevaluated sum (Dekker)
+static inline DoubleDouble twoProd(double a, double b)
+{
+    const double split = 134217729.0;  // 2^27 + 1
+    double p = a * b;
+    double ta = split * a, tb = split * b;
+    double a_hi = ta - (ta - a), a_lo = a - a_hi;
+    double b_hi = tb - (tb - b), b_lo = b - b_hi;
+    DoubleDouble r = { p, ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo };
+    return r;
+}
+
+static inline DoubleDouble ddAdd(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble s = twoSum(a.hi, b.hi);
+    DoubleDouble t = twoSum(a.lo, b.lo);
+    s = quickTwoSum(s.hi, s.lo + t.hi);
+    return quickTwoSum(s.hi, s.lo + t.lo);
+}
+
+static inline DoubleDouble ddSub(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble nb = { -b.hi, -b.lo };
+    return ddAdd(a, nb);
+}
+
+static inline DoubleDouble ddMul(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble p = twoProd(a.hi, b.hi);
+    return quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+//
+// mandelbrotReferenceOrbit --
+//
+// Computes W_0 = 0, W_{m+1} = W_m^2 + C for C = (cx_hi + cx_lo,
+// cy_hi + cy_lo) in double-double and stores it rounded to double in
+// orbit_re/orbit_im, which must hold maxIterations + 2 entries.  Stops
+// after the first W_m with |W_m| > 2.  Returns the number of entries.
+int mandelbrotReferenceOrbit(
+    double cx_hi, double cx_lo, double cy_hi, double cy_lo,
+    int maxIterations,
+    double orbit_re[], double orbit_im[])
+{
+    DoubleDouble c_re = { cx_hi, cx_lo };
+    DoubleDouble c_im = { cy_hi, cy_lo };
+    DoubleDouble w_re = ddFromDouble(0.0), w_im = ddFromDouble(0.0);
+
+    int m = 0;
+    orbit_re[0] = 0.0;
+    orbit_im[0] = 0.0;
+
+    while (m <= maxIterations) {
+        DoubleDouble re2 = ddMul(w_re, w_re);
+        DoubleDouble im2 = ddMul(w_im, w_im);
+        DoubleDouble rim = ddMul(w_re, w_im);
+        w_re = ddAdd(ddSub(re2, im2), c_re);
+        w_im = ddAdd(ddAdd(rim, rim), c_im);
+
+        m++;
+        orbit_re[m] = w_re.hi + w_re.lo;
+        orbit_im[m] = w_im.hi + w_im.lo;
+
+        if (orbit_re[m] * orbit_re[m] + orbit_im[m] * orbit_im[m] > 4.0)
+            break;
+    }
+
+    return m + 1;
+}
+
+//
+// mandelDeep --
+//
+// Iteration count of the pixel at C + (offset_re, offset_im), counted like
+// mandel() in mandelbrotSerial.cpp, with the whole orbit in double-double.
+int mandelDeep(
+    double cx_hi, double cx_lo, double cy_hi, double cy_lo,
+    double offset_re, double offset_im,
+    int maxIterations)
+{
+    DoubleDouble c_re = ddAdd(DoubleDouble{ cx_hi, cx_lo }, ddFromDouble(offset_re));
+    DoubleDouble c_im = ddAdd(DoubleDouble{ cy_hi, cy_lo }, ddFromDouble(offset_im));
+    DoubleDouble z_re = c_re, z_im = c_im;
+
+    int i;
+    for (i = 0; i < maxIterations; ++i) {
+        DoubleDouble re2 = ddMul(z_re, z_re);
+        DoubleDouble im2 = ddMul(z_im, z_im);
+
+        if (re2.hi + im2.hi > 4.0)
+            break;
+
+        DoubleDouble rim = ddMul(z_re, z_im);
+        z_re = ddAdd(ddSub(re2, im2), c_re);
+        z_im = ddAdd(ddAdd(rim, rim), c_im);
+    }
+
+    return i;
+}
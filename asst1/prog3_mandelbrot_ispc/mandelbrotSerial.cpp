@@ -56,6 +56,59 @@ static inline int mandel(float c_re, float c_im, int count)
     return i;
 }
 
+//
+// Cheaper mandel() for points that never escape, returning exactly the
+// same counts:
+//
+// * points inside the main cardioid or the period-2 bulb are known to be
+//   in the set and return count without iterating.
+// * otherwise z is compared against a value saved at doubling intervals
+//   (Brent's method).  The float iteration is deterministic, so once z
+//   repeats bit for bit the orbit is periodic, can never escape, and the
+//   loop would have run to count anyway.
+//
+static inline bool inCardioidOrBulb(float c_re, float c_im)
+{
+    float c_im2 = c_im * c_im;
+    float x = c_re - 0.25f;
+    float q = x * x + c_im2;
+    if (q * (q + x) <= 0.25f * c_im2)
+        return true;
+    return (c_re + 1.f) * (c_re + 1.f) + c_im2 <= 0.0625f;
+}
+
+static inline int mandelPruned(float c_re, float c_im, int count)
+{
+    if (inCardioidOrBulb(c_re, c_im))
+        return count;
+
+    float z_re = c_re, z_im = c_im;
+    float old_re = z_re, old_im = z_im;
+    int period = 0, checkInterval = 8;
+    int i;
+    for (i = 0; i < count; ++i) {
+
+        if (z_re * z_re + z_im * z_im > 4.f)
+            break;
+
+        float new_re = z_re*z_re - z_im*z_im;
+        float new_im = 2.f * z_re * z_im;
+        z_re = c_re + new_re;
+        z_im = c_im + new_im;
+
+        if (z_re == old_re && z_im == old_im)
+            return count;
+        if (++period == checkInterval) {
+            period = 0;
+            checkInterval *= 2;
+            old_re = z_re;
+            old_im = z_im;
+        }
+    }
+
+    return i;
+}
+
 //
 // MandelbrotSerial --
 //
@@ -90,3 +143,30 @@ void mandelbrotSerial(
     }
 }
 
+//
+// MandelbrotSerialPruned --
+//
+// mandelbrotSerial with interior and cycle rejection (see mandelPruned);
+// the output is identical.
+void mandelbrotSerialPruned(
+    float x0, float y0, float x1, float y1,
+    int width, int height,
+    int startRow, int totalRows,
+    int maxIterations,
+    int output[])
+{
+    float dx = (x1 - x0) / width;
+    float dy = (y1 - y0) / height;
+
+    int endRow = startRow + totalRows;
+
+    for (int j = startRow; j < endRow; j++) {
+        for (int i = 0; i < width; ++i) {
+            float x = x0 + i * dx;
+            float y = y0 + j * dy;
+
+            int index = (j * width + i);
+            output[index] = mandelPruned(x, y, maxIterations);
+        }
+    }
+}
@@ -1,14 +1,33 @@
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
+#include <getopt.h>
 #include <pthread.h>
 #include <math.h>
 
 #include "CycleTimer.h"
+#include "firstTouch.h"
+#include "taskSpan.h"
 #include "sqrt_ispc.h"
 
 using namespace ispc;
 
 extern void sqrtSerial(int N, float startGuess, float* values, float* output);
+extern void sqrtAvx(int N, float* values, float* output);
+extern void bucketByIterations(int N, float* values, int* index);
+extern "C" void ISPCInitTaskSystem();
+
+// Newton steps sqrtSerial takes for x from initialGuess
+static int newtonSteps(float x, float initialGuess) {
+    static const float kThreshold = 0.00001f;
+    float guess = initialGuess;
+    int steps = 0;
+    while (fabs(guess * guess * x - 1.f) > kThreshold) {
+        guess = (3.f * guess - x * guess * guess * guess) * 0.5f;
+        steps++;
+    }
+    return steps;
+}
 
 static void verifyResult(int N, float* result, float* gold) {
     for (int i=0; i<N; i++) {
@@ -18,14 +37,116 @@ static void verifyResult(int N, float* result, float* gold) {
     }
 }
 
-int main() {
+// minimum time of three runs of kernel()
+template <typename Kernel>
+static double minTime(Kernel kernel) {
+    double minKernel = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        kernel();
+        double endTime = CycleTimer::currentSeconds();
+        minKernel = std::min(minKernel, endTime - startTime);
+    }
+    return minKernel;
+}
+
+void usage(const char* progname) {
+    printf("Usage: %s [options]\n", progname);
+    printf("Program Options:\n");
+    printf("  -t  --touch <serial|parallel>  Place the arrays' pages from the main thread,\n");
+    printf("                     or split over all hardware threads, one pinned share each,\n");
+    printf("                     so they spread over NUMA nodes (default parallel)\n");
+    printf("  -H  --hugepages    Back the arrays with transparent huge pages\n");
+    printf("  -n  --size <N>     Number of elements (default 20M)\n");
+    printf("  -o  --oversubscribe <F>  Tasks per hardware thread for the task version\n");
+    printf("                     (default %d; spans are also capped to fit in L2)\n", DEFAULT_OVERSUBSCRIPTION);
+    printf("  -w  --sweep        Also time the task version over a range of task counts\n");
+    printf("  -?  --help         This message\n");
+}
+
+int main(int argc, char** argv) {
+
+    TouchPolicy touch = TOUCH_PARALLEL;
+    bool hugePages = false;
+    unsigned int N = 20 * 1000 * 1000;
+    int oversubscription = DEFAULT_OVERSUBSCRIPTION;
+    bool sweep = false;
+
+    // parse commandline options ////////////////////////////////////////////
+    int opt;
+    static struct option long_options[] = {
+        {"touch", 1, 0, 't'},
+        {"hugepages", 0, 0, 'H'},
+        {"size", 1, 0, 'n'},
+        {"oversubscribe", 1, 0, 'o'},
+        {"sweep", 0, 0, 'w'},
+        {"help", 0, 0, '?'},
+        {0 ,0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "t:Hn:o:w?", long_options, NULL)) != EOF) {
+
+        switch (opt) {
+        case 't':
+            if (strcmp(optarg, "serial") == 0) {
+                touch = TOUCH_SERIAL;
+            } else if (strcmp(optarg, "parallel") == 0) {
+                touch = TOUCH_PARALLEL;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'H':
+            hugePages = true;
+            break;
+        case 'n':
+            if (atoi(optarg) <= 0) {
+                printf("Error: size must be positive\n");
+                return 1;
+            }
+            N = atoi(optarg);
+            break;
+        case 'o':
+            oversubscription = atoi(optarg);
+            if (oversubscription <= 0) {
+                printf("Error: oversubscription must be positive\n");
+                return 1;
+            }
+            break;
+        case 'w':
+            sweep = true;
+            break;
+        case '?':
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // end parsing of commandline options //////////////////////////////////////
 
-    const unsigned int N = 20 * 1000 * 1000;
     const float initialGuess = 1.0f;
 
-    float* values = new float[N];
-    float* output = new float[N];
-    float* gold = new float[N];
+    // start the task system's worker threads before anything is timed
+    ISPCInitTaskSystem();
+
+    // The first write to each page decides its NUMA node.  values is
+    // filled from rand(), which has to stay on one thread to give the same
+    // sequence, so its pages are placed first and filled afterwards.
+    double initStart = CycleTimer::currentSeconds();
+    float* values = allocFirstTouch<float>(N, touch, hugePages);
+    float* output = allocFirstTouch<float>(N, touch, hugePages);
+    float* gold = allocFirstTouch<float>(N, touch, hugePages);
+    int* index = allocFirstTouch<int>(N, touch, hugePages);
+    if (!values || !output || !gold || !index) {
+        printf("Error: could not allocate %u-element arrays\n", N);
+        return 1;
+    }
+    double initTime = CycleTimer::currentSeconds() - initStart;
+
+    printf("[%s init]:\t\t[%.3f] ms\t(%s pages)\n",
+           touch == TOUCH_SERIAL ? "serial" : "parallel", initTime * 1000,
+           hugePages ? "huge" : "small");
 
     for (unsigned int i=0; i<N; i++)
     {
@@ -88,26 +209,165 @@ int main() {
         output[i] = 0;
 
     //
-    // Tasking version of the ISPC code
+    // Tasking version of the ISPC code; each element reads and writes one
+    // float
     //
+    int span = chooseTaskSpan(N, 2 * sizeof(float), oversubscription);
     double minTaskISPC = 1e30;
     for (int i = 0; i < 3; ++i) {
         double startTime = CycleTimer::currentSeconds();
-        sqrt_ispc_withtasks(N, initialGuess, values, output);
+        sqrt_ispc_withtasks(N, initialGuess, values, output, span);
         double endTime = CycleTimer::currentSeconds();
         minTaskISPC = std::min(minTaskISPC, endTime - startTime);
     }
 
-    printf("[sqrt task ispc]:\t[%.3f] ms\n", minTaskISPC * 1000);
+    printf("[sqrt task ispc]:\t[%.3f] ms\t(%d tasks of %d)\n",
+           minTaskISPC * 1000, (N + span - 1) / span, span);
 
     verifyResult(N, output, gold);
 
+    if (sweep) {
+        int numThreads = std::max(1u, std::thread::hardware_concurrency());
+        const int tasksPerThread[] = { 1, 2, 4, 8, 16, 64, 256 };
+        for (unsigned int k = 0; k < sizeof(tasksPerThread) / sizeof(tasksPerThread[0]); ++k) {
+            int sweepSpan = spanForTasks(N, tasksPerThread[k] * numThreads);
+
+            for (unsigned int i = 0; i < N; ++i)
+                output[i] = 0;
+            double t = minTime([&] { sqrt_ispc_withtasks(N, initialGuess, values, output, sweepSpan); });
+            verifyResult(N, output, gold);
+
+            printf("[tasks %d, span %d]:\t[%.3f] ms\t(%.2fx speedup)\n",
+                   (N + sweepSpan - 1) / sweepSpan, sweepSpan, t * 1000, minSerial / t);
+        }
+    }
+
+    // Clear out the buffer
+    for (unsigned int i = 0; i < N; ++i)
+        output[i] = 0;
+
+    //
+    // ISPC version that refills converged program instances
+    //
+    double minCompactISPC = 1e30;
+    long long compactSteps = 0;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        compactSteps = sqrt_ispc_compacted(N, initialGuess, values, output);
+        double endTime = CycleTimer::currentSeconds();
+        minCompactISPC = std::min(minCompactISPC, endTime - startTime);
+    }
+
+    printf("[sqrt compacted ispc]:\t[%.3f] ms\n", minCompactISPC * 1000);
+
+    verifyResult(N, output, gold);
+
+    //
+    // ISPC versions over indices bucketed by expected Newton steps; the
+    // bucketing is timed on its own and added to the kernel times below
+    //
+    double minBucket = minTime([&] { bucketByIterations(N, values, index); });
+
+    printf("[bucketing pre-pass]:\t[%.3f] ms\n", minBucket * 1000);
+
+    for (unsigned int i = 0; i < N; ++i)
+        output[i] = 0;
+
+    double minBucketISPC = minTime([&] {
+        sqrt_ispc_indexed(N, initialGuess, values, index, output);
+    });
+
+    printf("[sqrt bucketed ispc]:\t[%.3f] ms\n", minBucketISPC * 1000);
+
+    verifyResult(N, output, gold);
+
+    for (unsigned int i = 0; i < N; ++i)
+        output[i] = 0;
+
+    // each element also reads its index
+    int indexedSpan = chooseTaskSpan(N, 2 * sizeof(float) + sizeof(int), oversubscription);
+    double minBucketTaskISPC = minTime([&] {
+        sqrt_ispc_indexed_withtasks(N, initialGuess, values, index, output, indexedSpan);
+    });
+
+    printf("[sqrt bucketed task ispc]:\t[%.3f] ms\n", minBucketTaskISPC * 1000);
+
+    verifyResult(N, output, gold);
+
+    // Fraction of program instances doing a Newton step in each gang-wide
+    // step.  foreach runs each gang of consecutive elements (in values, or
+    // in index for the bucketed version) for as many steps as its slowest
+    // element needs.
+    int gangSize = sqrt_ispc_gang_size();
+    long long usefulSteps = 0, foreachSteps = 0, bucketedSteps = 0;
+    for (unsigned int i = 0; i < N; i += gangSize) {
+        int slowest = 0, slowestBucketed = 0;
+        for (unsigned int j = i; j < std::min(N, i + gangSize); j++) {
+            int steps = newtonSteps(values[j], initialGuess);
+            usefulSteps += steps;
+            slowest = std::max(slowest, steps);
+            slowestBucketed = std::max(slowestBucketed, newtonSteps(values[index[j]], initialGuess));
+        }
+        foreachSteps += slowest;
+        bucketedSteps += slowestBucketed;
+    }
+    printf("[lane utilization]:\t[%.1f%%] ispc\t[%.1f%%] compacted ispc\t[%.1f%%] bucketed ispc\n",
+           100.0 * usefulSteps / (foreachSteps * gangSize),
+           100.0 * usefulSteps / (compactSteps * gangSize),
+           100.0 * usefulSteps / (bucketedSteps * gangSize));
+
     printf("\t\t\t\t(%.2fx speedup from ISPC)\n", minSerial/minISPC);
     printf("\t\t\t\t(%.2fx speedup from task ISPC)\n", minSerial/minTaskISPC);
+    printf("\t\t\t\t(%.2fx speedup from compacted ISPC)\n", minSerial/minCompactISPC);
+    printf("\t\t\t\t(%.2fx speedup from bucketed ISPC, %.2fx with the pre-pass)\n",
+           minSerial/minBucketISPC, minSerial/(minBucket + minBucketISPC));
+    printf("\t\t\t\t(%.2fx speedup from bucketed task ISPC, %.2fx with the pre-pass)\n",
+           minSerial/minBucketTaskISPC, minSerial/(minBucket + minBucketTaskISPC));
+
+
+    //
+    // The fixed-step kernels take the same time for every input, while the
+    // Newton loop runs longest for values near 3 and diverges most when
+    // one value per gang is near 3 and the rest are 1.
+    //
+    const char* inputNames[] = { "random", "best case", "worst case" };
+    for (int input = 0; input < 3; ++input) {
+        for (unsigned int i=0; i<N; i++) {
+            if (input == 0)
+                values[i] = .001f + 2.998f * static_cast<float>(rand()) / RAND_MAX;
+            else if (input == 1)
+                values[i] = 2.999999f;
+            else
+                values[i] = (i % 8 == 0) ? 2.999999f : 1.0f;
+            gold[i] = sqrt(values[i]);
+        }
+
+        printf("\n[%s input]\n", inputNames[input]);
+
+        double minSerial = minTime([&] { sqrtSerial(N, initialGuess, values, output); });
+        printf("[sqrt serial]:\t\t[%.3f] ms\n", minSerial * 1000);
+        verifyResult(N, output, gold);
+
+        double minISPC = minTime([&] { sqrt_ispc(N, initialGuess, values, output); });
+        printf("[sqrt ispc]:\t\t[%.3f] ms\t(%.2fx speedup)\n",
+               minISPC * 1000, minSerial / minISPC);
+        verifyResult(N, output, gold);
+
+        double minFastISPC = minTime([&] { sqrt_ispc_fast(N, values, output); });
+        printf("[sqrt fast ispc]:\t[%.3f] ms\t(%.2fx speedup)\n",
+               minFastISPC * 1000, minSerial / minFastISPC);
+        verifyResult(N, output, gold);
+
+        double minAvx = minTime([&] { sqrtAvx(N, values, output); });
+        printf("[sqrt avx]:\t\t[%.3f] ms\t(%.2fx speedup)\n",
+               minAvx * 1000, minSerial / minAvx);
+        verifyResult(N, output, gold);
+    }
 
-    delete [] values;
-    delete [] output;
-    delete [] gold;
+    free(values);
+    free(output);
+    free(gold);
+    free(index);
 
     return 0;
 }
@@ -0,0 +1,33 @@
+#include <immintrin.h>
+
+//
+// sqrtAvx --
+//
+// sqrt(values[i]) for 8 elements at a time, as x * 1/sqrt(x).  The
+// estimate of 1/sqrt(x) from _mm256_rsqrt_ps has a relative error below
+// 1.5 * 2^-12, and one Newton step, guess * (1.5 - 0.5 * x * guess^2),
+// brings |guess^2 * x - 1| below 1e-6, under the kThreshold the Newton
+// loop in sqrtSerial stops at.  The number of steps is the same for every
+// element, so there is no loop to diverge.
+void sqrtAvx(int N,
+             float values[],
+             float output[])
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int i=0; i<N; i+=8) {
+
+        // all lanes, or the first N-i in the last iteration
+        __m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(N - i), laneIndex);
+
+        __m256 x = _mm256_maskload_ps(values + i, active);
+        __m256 guess = _mm256_rsqrt_ps(x);
+
+        __m256 xg2 = _mm256_mul_ps(_mm256_mul_ps(x, guess), guess);
+        guess = _mm256_mul_ps(guess, _mm256_sub_ps(threeHalves, _mm256_mul_ps(half, xg2)));
+
+        _mm256_maskstore_ps(output + i, active, _mm256_mul_ps(x, guess));
+    }
+}
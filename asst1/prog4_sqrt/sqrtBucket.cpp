@@ -0,0 +1,41 @@
+#include <string.h>
+#include <vector>
+
+//
+// bucketByIterations --
+//
+// Fills index with a permutation of 0..N-1 that puts values needing
+// similar numbers of Newton steps next to each other, so the gangs of
+// sqrt_ispc_indexed rarely wait on one slow element.  How many steps x
+// takes from a fixed initial guess depends on how far x is from 1 in
+// relative terms, which the exponent and the leading mantissa bits give
+// without any arithmetic: values are bucketed by the top 12 bits of their
+// float representation (sign, exponent and 3 mantissa bits), so each
+// bucket spans at most 12.5% of an octave.
+//
+// The sort is a stable counting sort, so indices within a bucket stay in
+// increasing order and the gathers over them move forward through memory.
+void bucketByIterations(int N,
+                        float values[],
+                        int index[])
+{
+    static const int kBucketBits = 12;
+    static const int kBuckets = 1 << kBucketBits;
+
+    std::vector<int> start(kBuckets + 1, 0);
+
+    for (int i=0; i<N; i++) {
+        unsigned int bits;
+        memcpy(&bits, &values[i], sizeof(bits));
+        start[(bits >> (32 - kBucketBits)) + 1]++;
+    }
+
+    for (int b=0; b<kBuckets; b++)
+        start[b + 1] += start[b];
+
+    for (int i=0; i<N; i++) {
+        unsigned int bits;
+        memcpy(&bits, &values[i], sizeof(bits));
+        index[start[bits >> (32 - kBucketBits)]++] = i;
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef FUSED_OPS_H_
+#define FUSED_OPS_H_
+
+//
+// Elementwise float kernels written as expressions and run in one pass.
+//
+// An expression like scale * X + Y builds a tree of small structs (one
+// node per operation) instead of computing anything; assigning it with
+// fusedAssign evaluates the whole tree per element, so no temporary array
+// is written.  fusedEvaluate then runs several statements -- assignments
+// and dot products -- over the same range block by block: every
+// statement handles one cache-sized block before the next block is
+// touched, so an array written by one statement is still in cache when a
+// later statement reads it.  Blocks are split over threads in contiguous
+// chunks.
+//
+//   float dot;
+//   fusedEvaluate(N, 0, fusedAssign(Z, a * fusedArray(X) + fusedArray(Y)),
+//                       fusedAssign(W, b * fusedArray(Z)),
+//                       fusedDot(&dot, fusedArray(W), fusedArray(X)));
+//
+// reads X and Y from memory once, where three separate passes would read
+// X twice and re-read Z and W.
+//
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// floats per block and array: 8 KB, so a few arrays' blocks fit in L1
+#define FUSED_BLOCK 2048
+
+template <typename Derived>
+struct FusedExpr {
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+};
+
+struct FusedArray : FusedExpr<FusedArray> {
+    const float* data;
+    explicit FusedArray(const float* d) : data(d) {}
+    float operator[](int i) const { return data[i]; }
+};
+
+struct FusedConst : FusedExpr<FusedConst> {
+    float value;
+    explicit FusedConst(float v) : value(v) {}
+    float operator[](int) const { return value; }
+};
+
+struct FusedAdd { static float apply(float a, float b) { return a + b; } };
+struct FusedSub { static float apply(float a, float b) { return a - b; } };
+struct FusedMul { static float apply(float a, float b) { return a * b; } };
+
+template <typename Op, typename L, typename R>
+struct FusedBinary : FusedExpr<FusedBinary<Op, L, R> > {
+    L l;
+    R r;
+    FusedBinary(const L& l_, const R& r_) : l(l_), r(r_) {}
+    float operator[](int i) const { return Op::apply(l[i], r[i]); }
+};
+
+inline FusedArray fusedArray(const float* data) { return FusedArray(data); }
+
+#define FUSED_OPERATOR(op, Op)                                                      \
+    template <typename L, typename R>                                               \
+    FusedBinary<Op, L, R> operator op(const FusedExpr<L>& l, const FusedExpr<R>& r) { \
+        return FusedBinary<Op, L, R>(l.self(), r.self());                           \
+    }                                                                               \
+    template <typename R>                                                           \
+    FusedBinary<Op, FusedConst, R> operator op(float l, const FusedExpr<R>& r) {    \
+        return FusedBinary<Op, FusedConst, R>(FusedConst(l), r.self());             \
+    }                                                                               \
+    template <typename L>                                                           \
+    FusedBinary<Op, L, FusedConst> operator op(const FusedExpr<L>& l, float r) {    \
+        return FusedBinary<Op, L, FusedConst>(l.self(), FusedConst(r));             \
+    }
+
+FUSED_OPERATOR(+, FusedAdd)
+FUSED_OPERATOR(-, FusedSub)
+FUSED_OPERATOR(*, FusedMul)
+
+#undef FUSED_OPERATOR
+
+//
+// Statements.  Each has start(numThreads) before the pass, run(thread,
+// begin, end) on every block, and finish() after it.
+//
+
+// dest[i] = expr[i]
+template <typename E>
+struct FusedAssign {
+    float* dest;
+    E expr;
+    FusedAssign(float* d, const E& e) : dest(d), expr(e) {}
+    void start(int) {}
+    void run(int, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            dest[i] = expr[i];
+    }
+    void finish() {}
+};
+
+// *result = sum of a[i] * b[i], accumulated per thread in double
+template <typename A, typename B>
+struct FusedDot {
+    float* result;
+    A a;
+    B b;
+    // one cache line per thread, so the partial sums do not share lines
+    std::vector<double> partial;
+    FusedDot(float* r, const A& a_, const B& b_) : result(r), a(a_), b(b_) {}
+    void start(int numThreads) { partial.assign(numThreads * 8, 0.0); }
+    void run(int thread, int begin, int end) {
+        // eight independent sums, so the compiler can keep them in one
+        // vector register instead of waiting on each add
+        float sums[8] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+        int i = begin;
+        for (; i + 8 <= end; i += 8)
+            for (int k = 0; k < 8; k++)
+                sums[k] += a[i + k] * b[i + k];
+        for (; i < end; i++)
+            sums[0] += a[i] * b[i];
+        for (int k = 0; k < 8; k++)
+            partial[thread * 8] += sums[k];
+    }
+    void finish() {
+        double sum = 0.0;
+        for (size_t t = 0; t < partial.size(); t += 8)
+            sum += partial[t];
+        *result = static_cast<float>(sum);
+    }
+};
+
+template <typename E>
+FusedAssign<E> fusedAssign(float* dest, const FusedExpr<E>& expr) {
+    return FusedAssign<E>(dest, expr.self());
+}
+
+template <typename A, typename B>
+FusedDot<A, B> fusedDot(float* result, const FusedExpr<A>& a, const FusedExpr<B>& b) {
+    return FusedDot<A, B>(result, a.self(), b.self());
+}
+
+//
+// fusedEvaluate --
+//
+// Runs the statements over [0, N) in one pass: numThreads contiguous
+// chunks (0 means one per hardware thread), each walked in blocks of
+// FUSED_BLOCK elements, with every statement run on a block, in order,
+// before the next block.  A statement may read what an earlier one
+// wrote at the same index, but not at other indices.
+template <typename... Statements>
+void fusedEvaluate(int N, int numThreads, Statements&&... statements) {
+    if (numThreads <= 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    (statements.start(numThreads), ...);
+
+    int chunk = ((N + numThreads - 1) / numThreads + 15) & ~15;
+    auto worker = [&](int thread) {
+        int chunkEnd = std::min(N, (thread + 1) * chunk);
+        for (int begin = thread * chunk; begin < chunkEnd; begin += FUSED_BLOCK) {
+            int end = std::min(chunkEnd, begin + FUSED_BLOCK);
+            (statements.run(thread, begin, end), ...);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; t++)
+        threads.push_back(std::thread(worker, t));
+    worker(0);
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    (statements.finish(), ...);
+}
+
+#endif
@@ -1,23 +1,49 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <algorithm>
+#include <getopt.h>
 
 #include "CycleTimer.h"
+#include "firstTouch.h"
+#include "taskSpan.h"
 #include "saxpy_ispc.h"
 
 extern void saxpySerial(int N, float a, float* X, float* Y, float* result);
+extern void saxpyStream(int N, float a, float* X, float* Y, float* result, int prefetchDistance);
+extern float saxpyChainUnfused(int N, float a, float b, float* X, float* Y, float* Z, float* W);
+extern float saxpyChainFused(int N, float a, float b, float* X, float* Y, float* Z, float* W);
+extern float saxpyChainFusedTemp(int N, float a, float b, float* X, float* Y, float* W);
+extern void measureStreamPeak(int N, float* a, float* b, float* c,
+                              int* numThreads, double* readBW, double* triadBW);
+extern "C" void ISPCInitTaskSystem();
 
 
 // return GB/s
 static float
-toBW(int bytes, float sec) {
+toBW(double bytes, float sec) {
     return static_cast<float>(bytes) / (1024. * 1024. * 1024.) / sec;
 }
 
 static float
-toGFLOPS(int ops, float sec) {
+toGFLOPS(double ops, float sec) {
     return static_cast<float>(ops) / 1e9 / sec;
 }
 
+// minimum time of three runs of kernel()
+template <typename Kernel>
+static double minTime(Kernel kernel) {
+    double minKernel = 1e30;
+    for (int i = 0; i < 3; ++i) {
+        double startTime = CycleTimer::currentSeconds();
+        kernel();
+        double endTime = CycleTimer::currentSeconds();
+        minKernel = std::min(minKernel, endTime - startTime);
+    }
+    return minKernel;
+}
+
 static void verifyResult(int N, float* result, float* gold) {
     for (int i=0; i<N; i++) {
         if (result[i] != gold[i]) {
@@ -28,30 +54,129 @@ static void verifyResult(int N, float* result, float* gold) {
 
 using namespace ispc;
 
+void usage(const char* progname) {
+    printf("Usage: %s [options]\n", progname);
+    printf("Program Options:\n");
+    printf("  -t  --touch <serial|parallel>  Initialize the arrays on the main thread, or\n");
+    printf("                     split over all hardware threads, one pinned share each,\n");
+    printf("                     so their pages spread over NUMA nodes (default parallel)\n");
+    printf("  -H  --hugepages    Back the arrays with transparent huge pages\n");
+    printf("  -n  --size <N>     Number of elements (default 20M)\n");
+    printf("  -o  --oversubscribe <F>  Tasks per hardware thread for the task versions\n");
+    printf("                     (default %d; spans are also capped to fit in L2)\n", DEFAULT_OVERSUBSCRIPTION);
+    printf("  -w  --sweep        Also time the task versions over a range of task counts\n");
+    printf("  -?  --help         This message\n");
+}
+
 
-int main() {
+int main(int argc, char** argv) {
 
-    const unsigned int N = 20 * 1000 * 1000; // 20 M element vectors (~80 MB)
-    const unsigned int TOTAL_BYTES = 4 * N * sizeof(float);
-    const unsigned int TOTAL_FLOPS = 2 * N;
+    TouchPolicy touch = TOUCH_PARALLEL;
+    bool hugePages = false;
+    unsigned int N = 20 * 1000 * 1000; // 20 M element vectors (~80 MB)
+    int oversubscription = DEFAULT_OVERSUBSCRIPTION;
+    bool sweep = false;
+
+    // parse commandline options ////////////////////////////////////////////
+    int opt;
+    static struct option long_options[] = {
+        {"touch", 1, 0, 't'},
+        {"hugepages", 0, 0, 'H'},
+        {"size", 1, 0, 'n'},
+        {"oversubscribe", 1, 0, 'o'},
+        {"sweep", 0, 0, 'w'},
+        {"help", 0, 0, '?'},
+        {0 ,0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "t:Hn:o:w?", long_options, NULL)) != EOF) {
+
+        switch (opt) {
+        case 't':
+            if (strcmp(optarg, "serial") == 0) {
+                touch = TOUCH_SERIAL;
+            } else if (strcmp(optarg, "parallel") == 0) {
+                touch = TOUCH_PARALLEL;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'H':
+            hugePages = true;
+            break;
+        case 'n':
+            if (atoi(optarg) <= 0) {
+                printf("Error: size must be positive\n");
+                return 1;
+            }
+            N = atoi(optarg);
+            break;
+        case 'o':
+            oversubscription = atoi(optarg);
+            if (oversubscription <= 0) {
+                printf("Error: oversubscription must be positive\n");
+                return 1;
+            }
+            break;
+        case 'w':
+            sweep = true;
+            break;
+        case '?':
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // end parsing of commandline options //////////////////////////////////////
+
+    // X and Y are read and result is written, and with ordinary stores
+    // every line of result is also read first (write-allocate): 4 streams.
+    // Streaming stores skip that read: 3 streams.  In double, since at
+    // hundreds of millions of elements they no longer fit in 32 bits.
+    const double TOTAL_BYTES = 4. * N * sizeof(float);
+    const double STREAM_BYTES = 3. * N * sizeof(float);
+    const double TOTAL_FLOPS = 2. * N;
+
+    // task counts --sweep times each task version at
+    const int tasksPerThread[] = { 1, 2, 4, 8, 16, 64, 256 };
+    const int numSweeps = sizeof(tasksPerThread) / sizeof(tasksPerThread[0]);
+    const int numThreads = std::max(1u, std::thread::hardware_concurrency());
 
     float scale = 2.f;
 
-    float* arrayX = new float[N];
-    float* arrayY = new float[N];
-    float* resultSerial = new float[N];
-    float* resultISPC = new float[N];
-    float* resultTasks = new float[N];
-
-    // initialize array values
-    for (unsigned int i=0; i<N; i++)
-    {
-        arrayX[i] = i;
-        arrayY[i] = i;
-        resultSerial[i] = 0.f;
-        resultISPC[i] = 0.f;
-        resultTasks[i] = 0.f;
+    // start the task system's worker threads before anything is timed
+    ISPCInitTaskSystem();
+
+    // page-aligned, so also aligned for the streaming stores; the first
+    // write to each page decides its NUMA node
+    double initStart = CycleTimer::currentSeconds();
+    float* arrayX = allocFirstTouch<float>(N, touch, hugePages, [](size_t i) { return (float)i; });
+    float* arrayY = allocFirstTouch<float>(N, touch, hugePages, [](size_t i) { return (float)i; });
+    float* resultSerial = allocFirstTouch<float>(N, touch, hugePages);
+    float* resultISPC = allocFirstTouch<float>(N, touch, hugePages);
+    float* resultTasks = allocFirstTouch<float>(N, touch, hugePages);
+    if (!arrayX || !arrayY || !resultSerial || !resultISPC || !resultTasks) {
+        printf("Error: could not allocate %u-element arrays\n", N);
+        return 1;
     }
+    double initTime = CycleTimer::currentSeconds() - initStart;
+
+    printf("[%s init]:\t\t[%.3f] ms\t(%s pages)\n",
+           touch == TOUCH_SERIAL ? "serial" : "parallel", initTime * 1000,
+           hugePages ? "huge" : "small");
+
+    //
+    // Measure the roofline: the most bandwidth this machine's memory gives
+    // a STREAM-style kernel on all cores.
+    //
+    int peakThreads;
+    double readBW, triadBW;
+    measureStreamPeak(N, arrayX, arrayY, resultTasks, &peakThreads, &readBW, &triadBW);
+    double peakBW = std::max(readBW, triadBW);
+
+    printf("[stream peak]:\t\t[%.3f] GB/s read\t[%.3f] GB/s triad\t(%d threads)\n",
+           readBW, triadBW, peakThreads);
 
     //
     // Run the serial implementation. Repeat three times for robust
@@ -92,30 +217,230 @@ int main() {
     //
     // Run the ISPC (multi-core) implementation
     //
+    int span = chooseTaskSpan(N, 4 * sizeof(float), oversubscription);
     double minTaskISPC = 1e30;
     for (int i = 0; i < 3; ++i) {
         double startTime = CycleTimer::currentSeconds();
-        saxpy_ispc_withtasks(N, scale, arrayX, arrayY, resultTasks);
+        saxpy_ispc_withtasks(N, scale, arrayX, arrayY, resultTasks, span);
         double endTime = CycleTimer::currentSeconds();
         minTaskISPC = std::min(minTaskISPC, endTime - startTime);
     }
 
     verifyResult(N, resultTasks, resultSerial);
 
-    printf("[saxpy task ispc]:\t[%.3f] ms\t[%.3f] GB/s\t[%.3f] GFLOPS\n",
+    printf("[saxpy task ispc]:\t[%.3f] ms\t[%.3f] GB/s\t[%.3f] GFLOPS\t(%d tasks of %d)\n",
            minTaskISPC * 1000,
            toBW(TOTAL_BYTES, minTaskISPC),
-           toGFLOPS(TOTAL_FLOPS, minTaskISPC));
+           toGFLOPS(TOTAL_FLOPS, minTaskISPC),
+           (N + span - 1) / span, span);
+
+    if (sweep) {
+        for (int k = 0; k < numSweeps; ++k) {
+            int sweepSpan = spanForTasks(N, tasksPerThread[k] * numThreads);
+
+            for (unsigned int i = 0; i < N; ++i)
+                resultTasks[i] = 0.f;
+            double t = minTime([&] { saxpy_ispc_withtasks(N, scale, arrayX, arrayY, resultTasks, sweepSpan); });
+            verifyResult(N, resultTasks, resultSerial);
+
+            printf("[tasks %d, span %d]:\t[%.3f] ms\t[%.3f] GB/s\n",
+                   (N + sweepSpan - 1) / sweepSpan, sweepSpan, t * 1000, toBW(TOTAL_BYTES, t));
+        }
+    }
 
     printf("\t\t\t\t(%.2fx speedup from use of tasks)\n", minSerial/minTaskISPC);
     //printf("\t\t\t\t(%.2fx speedup from ISPC)\n", minSerial/minISPC);
     //printf("\t\t\t\t(%.2fx speedup from task ISPC)\n", minSerial/minTaskISPC);
 
-    delete[] arrayX;
-    delete[] arrayY;
-    delete[] resultSerial;
-    delete[] resultISPC;
-    delete[] resultTasks;
+    //
+    // Streaming-store versions, over a range of prefetch distances (in
+    // elements; 0 is no software prefetch).  Their bandwidth counts the 3
+    // streams they move.
+    //
+    int streamSpan = chooseTaskSpan(N, 3 * sizeof(float), oversubscription);
+    const int prefetchDistances[] = { 0, 64, 256, 1024, 4096 };
+    const int numDistances = sizeof(prefetchDistances) / sizeof(prefetchDistances[0]);
+    double minStream = 1e30, minStreamISPC = 1e30, minStreamTaskISPC = 1e30;
+    int bestDistance = 0, bestDistanceISPC = 0, bestDistanceTaskISPC = 0;
+
+    for (int d = 0; d < numDistances; ++d) {
+        int distance = prefetchDistances[d];
+
+        double avxTime = minTime([&] {
+            saxpyStream(N, scale, arrayX, arrayY, resultISPC, distance);
+        });
+        verifyResult(N, resultISPC, resultSerial);
+
+        double ispcTime = minTime([&] {
+            saxpy_ispc_stream(N, scale, arrayX, arrayY, resultISPC, distance);
+        });
+        verifyResult(N, resultISPC, resultSerial);
+
+        double taskTime = minTime([&] {
+            saxpy_ispc_stream_withtasks(N, scale, arrayX, arrayY, resultTasks, distance, streamSpan);
+        });
+        verifyResult(N, resultTasks, resultSerial);
+
+        printf("[stream, prefetch %d]:\t[%.3f] GB/s avx\t[%.3f] GB/s ispc\t[%.3f] GB/s task ispc\n",
+               distance,
+               toBW(STREAM_BYTES, avxTime),
+               toBW(STREAM_BYTES, ispcTime),
+               toBW(STREAM_BYTES, taskTime));
+
+        if (avxTime < minStream) {
+            minStream = avxTime;
+            bestDistance = distance;
+        }
+        if (ispcTime < minStreamISPC) {
+            minStreamISPC = ispcTime;
+            bestDistanceISPC = distance;
+        }
+        if (taskTime < minStreamTaskISPC) {
+            minStreamTaskISPC = taskTime;
+            bestDistanceTaskISPC = distance;
+        }
+    }
+
+    if (sweep) {
+        for (int k = 0; k < numSweeps; ++k) {
+            int sweepSpan = spanForTasks(N, tasksPerThread[k] * numThreads);
+
+            for (unsigned int i = 0; i < N; ++i)
+                resultTasks[i] = 0.f;
+            double t = minTime([&] {
+                saxpy_ispc_stream_withtasks(N, scale, arrayX, arrayY, resultTasks,
+                                            bestDistanceTaskISPC, sweepSpan);
+            });
+            verifyResult(N, resultTasks, resultSerial);
+
+            printf("[stream tasks %d, span %d]:\t[%.3f] ms\t[%.3f] GB/s\t(prefetch %d)\n",
+                   (N + sweepSpan - 1) / sweepSpan, sweepSpan, t * 1000,
+                   toBW(STREAM_BYTES, t), bestDistanceTaskISPC);
+        }
+    }
+
+    //
+    // Roofline: bandwidth each version achieves, counting the streams it
+    // really moves, as a fraction of the peak.  The last column is what
+    // the ordinary-store versions would report if write-allocate were
+    // not counted, as STREAM does.
+    //
+    printf("\n[roofline, peak %.3f GB/s]\n", peakBW);
+    printf("[saxpy serial]:\t\t[%.3f] GB/s\t[%.1f%%] of peak\t(4 streams; %.3f GB/s as 3)\n",
+           toBW(TOTAL_BYTES, minSerial), 100. * toBW(TOTAL_BYTES, minSerial) / peakBW,
+           toBW(STREAM_BYTES, minSerial));
+    printf("[saxpy ispc]:\t\t[%.3f] GB/s\t[%.1f%%] of peak\t(4 streams; %.3f GB/s as 3)\n",
+           toBW(TOTAL_BYTES, minISPC), 100. * toBW(TOTAL_BYTES, minISPC) / peakBW,
+           toBW(STREAM_BYTES, minISPC));
+    printf("[saxpy task ispc]:\t[%.3f] GB/s\t[%.1f%%] of peak\t(4 streams; %.3f GB/s as 3)\n",
+           toBW(TOTAL_BYTES, minTaskISPC), 100. * toBW(TOTAL_BYTES, minTaskISPC) / peakBW,
+           toBW(STREAM_BYTES, minTaskISPC));
+    printf("[saxpy stream avx]:\t[%.3f] GB/s\t[%.1f%%] of peak\t(3 streams, prefetch %d)\n",
+           toBW(STREAM_BYTES, minStream), 100. * toBW(STREAM_BYTES, minStream) / peakBW,
+           bestDistance);
+    printf("[saxpy stream ispc]:\t[%.3f] GB/s\t[%.1f%%] of peak\t(3 streams, prefetch %d)\n",
+           toBW(STREAM_BYTES, minStreamISPC), 100. * toBW(STREAM_BYTES, minStreamISPC) / peakBW,
+           bestDistanceISPC);
+    printf("[saxpy stream task ispc]:\t[%.3f] GB/s\t[%.1f%%] of peak\t(3 streams, prefetch %d)\n",
+           toBW(STREAM_BYTES, minStreamTaskISPC), 100. * toBW(STREAM_BYTES, minStreamTaskISPC) / peakBW,
+           bestDistanceTaskISPC);
+    printf("\t\t\t\t(%.2fx speedup from streaming stores)\n", minISPC/minStreamISPC);
+    printf("\t\t\t\t(%.2fx speedup from streaming stores with tasks)\n", minTaskISPC/minStreamTaskISPC);
+
+    //
+    // The chain Z = scale * X + Y, W = scale2 * Z, dot = W . X, as three
+    // passes and fused into one (see saxpyChain.cpp for the traffic each
+    // moves).  GB/s counts that traffic.
+    //
+    const float scale2 = 0.5f;
+    float* arrayZ = allocFirstTouch<float>(N, touch, hugePages);
+    float* arrayW = allocFirstTouch<float>(N, touch, hugePages);
+    if (!arrayZ || !arrayW) {
+        printf("Error: could not allocate %u-element arrays\n", N);
+        return 1;
+    }
+    float* goldZ = resultSerial;
+    float* goldW = resultISPC;
+
+    double goldDot = 0.;
+    for (unsigned int i=0; i<N; i++) {
+        goldZ[i] = scale * arrayX[i] + arrayY[i];
+        goldW[i] = scale2 * goldZ[i];
+        goldDot += goldW[i] * arrayX[i];
+    }
+
+    struct {
+        const char* name;
+        int bytesPerElement;
+        double time;
+        float dot;
+    } chains[] = {
+        { "[chain unfused]:\t", 36, 0., 0.f },
+        { "[chain fused]:\t\t", 24, 0., 0.f },
+        { "[chain fused, Z temp]:", 16, 0., 0.f },
+        { "[chain fused ispc]:\t", 24, 0., 0.f },
+    };
+    const int numChains = sizeof(chains) / sizeof(chains[0]);
+    int chainSpan = chooseTaskSpan(N, chains[numChains - 1].bytesPerElement, oversubscription);
+
+    for (int c = 0; c < numChains; ++c) {
+        for (unsigned int i=0; i<N; i++) {
+            arrayZ[i] = 0.f;
+            arrayW[i] = 0.f;
+        }
+        chains[c].time = minTime([&] {
+            if (c == 0)
+                chains[c].dot = saxpyChainUnfused(N, scale, scale2, arrayX, arrayY, arrayZ, arrayW);
+            else if (c == 1)
+                chains[c].dot = saxpyChainFused(N, scale, scale2, arrayX, arrayY, arrayZ, arrayW);
+            else if (c == 2)
+                chains[c].dot = saxpyChainFusedTemp(N, scale, scale2, arrayX, arrayY, arrayW);
+            else
+                chains[c].dot = saxpy_chain_ispc_withtasks(N, scale, scale2, arrayX, arrayY, arrayZ, arrayW, chainSpan);
+        });
+
+        if (c != 2)
+            verifyResult(N, arrayZ, goldZ);
+        verifyResult(N, arrayW, goldW);
+        if (fabs(chains[c].dot - goldDot) > 1e-4 * fabs(goldDot))
+            printf("Error: dot %s got %f expected %f\n", chains[c].name, chains[c].dot, goldDot);
+
+        printf("%s\t[%.3f] ms\t[%.3f] GB/s\t[%d] bytes/element\t(%.2fx speedup)\n",
+               chains[c].name, chains[c].time * 1000,
+               toBW((double)chains[c].bytesPerElement * N, chains[c].time),
+               chains[c].bytesPerElement, chains[0].time / chains[c].time);
+    }
+
+    if (sweep) {
+        const double chainBytes = (double)chains[numChains - 1].bytesPerElement * N;
+        for (int k = 0; k < numSweeps; ++k) {
+            int sweepSpan = spanForTasks(N, tasksPerThread[k] * numThreads);
+
+            for (unsigned int i=0; i<N; i++) {
+                arrayZ[i] = 0.f;
+                arrayW[i] = 0.f;
+            }
+            float dot = 0.f;
+            double t = minTime([&] {
+                dot = saxpy_chain_ispc_withtasks(N, scale, scale2, arrayX, arrayY, arrayZ, arrayW, sweepSpan);
+            });
+            verifyResult(N, arrayZ, goldZ);
+            verifyResult(N, arrayW, goldW);
+            if (fabs(dot - goldDot) > 1e-4 * fabs(goldDot))
+                printf("Error: dot of chain with span %d got %f expected %f\n", sweepSpan, dot, goldDot);
+
+            printf("[chain tasks %d, span %d]:\t[%.3f] ms\t[%.3f] GB/s\n",
+                   (N + sweepSpan - 1) / sweepSpan, sweepSpan, t * 1000, toBW(chainBytes, t));
+        }
+    }
+
+    free(arrayZ);
+    free(arrayW);
+    free(arrayX);
+    free(arrayY);
+    free(resultSerial);
+    free(resultISPC);
+    free(resultTasks);
 
     return 0;
 }
@@ -0,0 +1,45 @@
+#include "fusedOps.h"
+
+//
+// The chain Z = scale * X + Y, W = scale2 * Z, returning W . X, written
+// three ways with fusedOps.h.  Memory traffic per element, counting
+// write-allocate on stores:
+//
+//   saxpyChainUnfused:   three passes                     36 bytes
+//                          X, Y, Z (+allocate)   16
+//                          Z, W (+allocate)      12
+//                          W, X                   8
+//   saxpyChainFused:     one blocked pass, Z and W kept   24 bytes
+//   saxpyChainFusedTemp: one pass, Z never stored         16 bytes
+//
+
+float saxpyChainUnfused(int N, float scale, float scale2,
+                        float X[], float Y[], float Z[], float W[])
+{
+    float dot;
+    fusedEvaluate(N, 0, fusedAssign(Z, scale * fusedArray(X) + fusedArray(Y)));
+    fusedEvaluate(N, 0, fusedAssign(W, scale2 * fusedArray(Z)));
+    fusedEvaluate(N, 0, fusedDot(&dot, fusedArray(W), fusedArray(X)));
+    return dot;
+}
+
+float saxpyChainFused(int N, float scale, float scale2,
+                      float X[], float Y[], float Z[], float W[])
+{
+    float dot;
+    fusedEvaluate(N, 0,
+                  fusedAssign(Z, scale * fusedArray(X) + fusedArray(Y)),
+                  fusedAssign(W, scale2 * fusedArray(Z)),
+                  fusedDot(&dot, fusedArray(W), fusedArray(X)));
+    return dot;
+}
+
+float saxpyChainFusedTemp(int N, float scale, float scale2,
+                          float X[], float Y[], float W[])
+{
+    float dot;
+    fusedEvaluate(N, 0,
+                  fusedAssign(W, scale2 * (scale * fusedArray(X) + fusedArray(Y))),
+                  fusedDot(&dot, fusedArray(W), fusedArray(X)));
+    return dot;
+}
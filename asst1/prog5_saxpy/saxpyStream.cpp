@@ -0,0 +1,45 @@
+#include <immintrin.h>
+#include <stdint.h>
+
+//
+// saxpyStream --
+//
+// saxpySerial with AVX and non-temporal stores (_mm256_stream_ps), so the
+// lines of result are not read into the cache before being overwritten:
+// 12 bytes of memory traffic per element instead of 16.  With
+// prefetchDistance > 0, X and Y are also prefetched that many elements
+// ahead.  Multiplies and adds are kept separate (no FMA) so the result is
+// bit-identical to saxpySerial.
+void saxpyStream(int N,
+                 float scale,
+                 float X[],
+                 float Y[],
+                 float result[],
+                 int prefetchDistance)
+{
+    int i = 0;
+
+    // streaming stores need result + i aligned to 32 bytes
+    for (; i < N && (reinterpret_cast<uintptr_t>(result + i) & 31); i++)
+        result[i] = scale * X[i] + Y[i];
+
+    const __m256 s = _mm256_set1_ps(scale);
+
+    // 16 elements, one 64-byte line of each array, per iteration
+    for (; i + 16 <= N; i += 16) {
+        if (prefetchDistance > 0) {
+            _mm_prefetch(reinterpret_cast<const char*>(X + i + prefetchDistance), _MM_HINT_T1);
+            _mm_prefetch(reinterpret_cast<const char*>(Y + i + prefetchDistance), _MM_HINT_T1);
+        }
+        __m256 lo = _mm256_add_ps(_mm256_mul_ps(s, _mm256_loadu_ps(X + i)), _mm256_loadu_ps(Y + i));
+        __m256 hi = _mm256_add_ps(_mm256_mul_ps(s, _mm256_loadu_ps(X + i + 8)), _mm256_loadu_ps(Y + i + 8));
+        _mm256_stream_ps(result + i, lo);
+        _mm256_stream_ps(result + i + 8, hi);
+    }
+
+    for (; i < N; i++)
+        result[i] = scale * X[i] + Y[i];
+
+    // make the streaming stores visible before anyone reads result
+    _mm_sfence();
+}
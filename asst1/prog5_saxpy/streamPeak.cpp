@@ -0,0 +1,93 @@
+#include <immintrin.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "CycleTimer.h"
+
+extern void saxpyStream(int N, float scale, float X[], float Y[], float result[], int prefetchDistance);
+
+// elements ahead to prefetch; far enough to cover memory latency
+static const int kPrefetchDistance = 1024;
+
+// sum of values[0..N-1], with four independent accumulators and software
+// prefetch so the loads are not serialized; only its traffic matters
+static float streamRead(int N, float values[])
+{
+    __m256 sum[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(),
+                      _mm256_setzero_ps(), _mm256_setzero_ps() };
+    int i = 0;
+    for (; i + 32 <= N; i += 32) {
+        _mm_prefetch(reinterpret_cast<const char*>(values + i + kPrefetchDistance), _MM_HINT_T1);
+        _mm_prefetch(reinterpret_cast<const char*>(values + i + kPrefetchDistance + 16), _MM_HINT_T1);
+        for (int k=0; k<4; k++)
+            sum[k] = _mm256_add_ps(sum[k], _mm256_loadu_ps(values + i + 8 * k));
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, _mm256_add_ps(_mm256_add_ps(sum[0], sum[1]),
+                                          _mm256_add_ps(sum[2], sum[3])));
+    float total = 0.f;
+    for (int j=0; j<8; j++)
+        total += lanes[j];
+    for (; i < N; i++)
+        total += values[i];
+    return total;
+}
+
+// best of five runs of kernel(thread, start, count) over [0, N), split
+// into one 64-byte aligned chunk per thread
+template <typename Kernel>
+static double minParallelTime(int N, int numThreads, Kernel kernel)
+{
+    int chunk = ((N + numThreads - 1) / numThreads + 15) & ~15;
+    double minTime = 1e30;
+    for (int run = 0; run < 5; ++run) {
+        std::vector<std::thread> threads;
+        double startTime = CycleTimer::currentSeconds();
+        for (int t = 0; t < numThreads; t++) {
+            int start = std::min(N, t * chunk);
+            int count = std::min(N - start, chunk);
+            threads.push_back(std::thread(kernel, t, start, count));
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+        minTime = std::min(minTime, CycleTimer::currentSeconds() - startTime);
+    }
+    return minTime;
+}
+
+//
+// measureStreamPeak --
+//
+// STREAM-style measurement of the machine's memory bandwidth, in GB/s
+// (2^30 bytes), using every hardware thread on N-element arrays a, b and
+// c (which it overwrites; c is written):
+//
+//   readBW:  sum of a, 4 bytes per element
+//   triadBW: c[i] = 3 * a[i] + b[i] with non-temporal stores, 12 bytes
+//            per element, all of which are really moved
+//
+// Both prefetch ahead in software, as STREAM relies on the compiler and
+// hardware prefetchers to keep enough loads in flight.
+//
+// The larger of the two is the roofline the saxpy variants are measured
+// against.
+void measureStreamPeak(int N, float* a, float* b, float* c,
+                       int* numThreads, double* readBW, double* triadBW)
+{
+    const double GB = 1024. * 1024. * 1024.;
+    *numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<float> sums(*numThreads * 16);
+    double readTime = minParallelTime(N, *numThreads, [&](int t, int start, int count) {
+        // one line per thread, so the sums do not share cache lines
+        sums[t * 16] = streamRead(count, a + start);
+    });
+    double triadTime = minParallelTime(N, *numThreads, [&](int, int start, int count) {
+        saxpyStream(count, 3.f, a + start, b + start, c + start, kPrefetchDistance);
+    });
+
+    *readBW = 4. * N / GB / readTime;
+    *triadBW = 12. * N / GB / triadTime;
+}
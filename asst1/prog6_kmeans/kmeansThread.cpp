@@ -1,14 +1,34 @@
 #include <algorithm>
 #include <math.h>
 #include <omp.h>
+#include <random>
 #include <stdio.h>
 #include <stdlib.h>
 #include <thread>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 #include "CycleTimer.h"
+#include "kmeansThread.h"
 
 using namespace std;
 
+// Mini-batch mode: the RNG seed that picks batch points, the centroid
+// movement per batch below which it stops, and how many points' worth of
+// batches, in multiples of M, it may take before that
+#define MINIBATCH_SEED 7
+#define MINIBATCH_TOLERANCE 1e-3
+#define MINIBATCH_MAX_PASSES 2
+
+// Relative margin by which a bound has to rule a centroid out.  Bounds are
+// built from rounded distances and the brute-force search compares rounded
+// squared distances, so a centroid only a rounding error farther away is
+// measured rather than skipped.
+#define BOUND_SLACK 1e-9
+
 typedef struct {
   // Control work assignments
   int start, end;
@@ -21,6 +41,52 @@ typedef struct {
   int M, N, K;
 } WorkerArgs;
 
+typedef struct {
+  // False until a full search of every point has set the bounds
+  bool valid;
+
+  // Per point: the squared distance to its centroid, which the cost pass
+  // measures after every update and so serves as an exact upper bound,
+  // and lower bounds on the distance to the others -- one for all of them
+  // (Hamerly) or one per centroid, M*K (Elkan)
+  double *upper;
+  double *lower;
+
+  // How far each centroid moved in the last update; farthest is the one
+  // that moved most, by maxDrift, and secondDrift the most any other moved
+  double *drift;
+  int farthest;
+  double maxDrift, secondDrift;
+
+  // Half the distance from each centroid to its nearest other centroid
+  // (K), and between every pair (K*K)
+  double *halfNearest;
+  double *halfBetween;
+} PruneState;
+
+typedef struct {
+  // Points handled by this thread: index[start] to index[end - 1], or
+  // start to end - 1 when index is NULL
+  int start, end;
+  int *index;
+
+  // Shared by all threads
+  double *data;
+  double *clusterCentroids;
+  int *clusterAssignments;
+  int M, N, K;
+
+  // This thread's own K*N centroid sums, K counts and K costs
+  double *sums;
+  int *counts;
+  double *cost;
+
+  // Bounds for the pruned assignment modes, and the number of distances
+  // this thread computed in the last assignment pass
+  PruneState *prune;
+  long distances;
+} PartitionArgs;
+
 
 /**
  * Checks if the algorithm has converged.
@@ -62,6 +128,41 @@ double dist(double *x, double *y, int nDim) {
   return sqrt(accum);
 }
 
+/**
+ * Computes the squared L2 distance between two points of dimension nDim.
+ * Nearest-centroid searches compare these directly, since sqrt does not
+ * change which distance is smallest.  The sum is split over eight lanes
+ * (two AVX registers), so it rounds slightly differently from dist.
+ */
+static inline double distSquared(const double *x, const double *y, int nDim) {
+  int i = 0;
+  double accum = 0.0;
+#if defined(__AVX__)
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  for (; i + 8 <= nDim; i += 8) {
+    __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i));
+    __m256d d1 =
+        _mm256_sub_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4));
+    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(d1, d1));
+  }
+  if (i + 4 <= nDim) {
+    __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i));
+    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+    i += 4;
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+  accum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+  for (; i < nDim; i++) {
+    double d = x[i] - y[i];
+    accum += d * d;
+  }
+  return accum;
+}
+
 /**
  * Assigns each data point to its "closest" cluster centroid.
  */
@@ -153,7 +254,250 @@ void computeCost(WorkerArgs *const args) {
 }
 
 /**
- * Computes the K-Means algorithm, using std::thread to parallelize the work.
+ * Assigns each of the thread's points to the centroid choose(m, point)
+ * returns and adds the point into the thread's centroid sums.  The sums
+ * are built in memory this thread allocated and copied out at the end, so
+ * threads never write the same cache line per point.  Assignments are not
+ * stored when clusterAssignments is NULL.
+ */
+template <typename Choose>
+static void assignWith(PartitionArgs *const args, Choose choose) {
+  int N = args->N;
+  int K = args->K;
+  vector<double> sums(K * N, 0.0);
+  vector<int> counts(K, 0);
+
+  for (int i = args->start; i < args->end; i++) {
+    int m = args->index ? args->index[i] : i;
+    const double *point = &args->data[(size_t)m * N];
+
+    int best = choose(m, point);
+
+    if (args->clusterAssignments)
+      args->clusterAssignments[m] = best;
+    for (int n = 0; n < N; n++) {
+      sums[best * N + n] += point[n];
+    }
+    counts[best]++;
+  }
+
+  copy(sums.begin(), sums.end(), args->sums);
+  copy(counts.begin(), counts.end(), args->counts);
+}
+
+// true if a centroid at least lower away is farther than one at most
+// upper away, by more than rounding
+static inline bool fartherThan(double lower, double upper) {
+  return lower > upper * (1.0 + BOUND_SLACK);
+}
+
+/**
+ * Assigns each point to its closest centroid, measuring all K.  Ties go to
+ * the lowest k, as in computeAssignments.
+ */
+static void assignPartition(PartitionArgs *const args) {
+  int N = args->N;
+  int K = args->K;
+  assignWith(args, [&](int m, const double *point) {
+    double minDist = HUGE_VAL;
+    int best = 0;
+    for (int k = 0; k < K; k++) {
+      double d = distSquared(point, &args->clusterCentroids[k * N], N);
+      if (d < minDist) {
+        minDist = d;
+        best = k;
+      }
+    }
+    return best;
+  });
+  args->distances = (long)(args->end - args->start) * K;
+}
+
+/**
+ * assignPartition with Hamerly's bounds.  After the centroids move, a
+ * point's lower bound shrinks by the largest drift of any other centroid.
+ * Every other centroid is then at least max(lower, halfNearest[a]) away --
+ * the second by the triangle inequality -- so while that exceeds the
+ * distance to a, which the cost pass left in upper, the point keeps its
+ * centroid.  Otherwise all K centroids are measured.  The chosen centroid
+ * is the same one assignPartition picks.
+ */
+static void assignHamerly(PartitionArgs *const args) {
+  int N = args->N;
+  int K = args->K;
+  PruneState *p = args->prune;
+  long distances = 0;
+
+  assignWith(args, [&](int m, const double *point) {
+    int a = args->clusterAssignments[m];
+    double distA = -1.0;
+    if (p->valid) {
+      distA = p->upper[m];
+      double lower =
+          p->lower[m] - (a == p->farthest ? p->secondDrift : p->maxDrift);
+      if (fartherThan(max(lower, p->halfNearest[a]), sqrt(distA))) {
+        p->lower[m] = lower;
+        return a;
+      }
+    }
+
+    // full search, reusing the distance to a if it is known
+    double minDist = HUGE_VAL, secondDist = HUGE_VAL;
+    int best = 0;
+    for (int k = 0; k < K; k++) {
+      double d = distA;
+      if (k != a || d < 0.0) {
+        d = distSquared(point, &args->clusterCentroids[k * N], N);
+        distances++;
+      }
+      if (d < minDist) {
+        secondDist = minDist;
+        minDist = d;
+        best = k;
+      } else if (d < secondDist) {
+        secondDist = d;
+      }
+    }
+    p->lower[m] = sqrt(secondDist);
+    return best;
+  });
+  args->distances = distances;
+}
+
+/**
+ * assignPartition with Elkan's bounds: one lower bound per centroid, each
+ * shrunk by that centroid's drift.  A point closer to a than halfNearest[a]
+ * keeps its centroid outright.  Otherwise centroid j is only measured if
+ * neither its lower bound nor halfBetween[a][j] (by the triangle
+ * inequality, every point within that of a is closer to a than to j) rules
+ * it out.  Ties go to the lowest k, so the chosen centroid is the same one
+ * assignPartition picks.
+ */
+static void assignElkan(PartitionArgs *const args) {
+  int N = args->N;
+  int K = args->K;
+  PruneState *p = args->prune;
+  long distances = 0;
+
+  assignWith(args, [&](int m, const double *point) {
+    double *lower = &p->lower[(size_t)m * K];
+
+    if (!p->valid) {
+      double minDist = HUGE_VAL;
+      int best = 0;
+      for (int k = 0; k < K; k++) {
+        double d = distSquared(point, &args->clusterCentroids[k * N], N);
+        lower[k] = sqrt(d);
+        if (d < minDist) {
+          minDist = d;
+          best = k;
+        }
+      }
+      distances += K;
+      return best;
+    }
+
+    int a = args->clusterAssignments[m];
+    double distA = p->upper[m];
+    double upper = sqrt(distA);
+    for (int k = 0; k < K; k++) {
+      lower[k] = max(0.0, lower[k] - p->drift[k]);
+    }
+
+    if (!fartherThan(p->halfNearest[a], upper)) {
+      for (int j = 0; j < K; j++) {
+        if (j == a || fartherThan(lower[j], upper) ||
+            fartherThan(p->halfBetween[a * K + j], upper))
+          continue;
+        double d = distSquared(point, &args->clusterCentroids[j * N], N);
+        distances++;
+        lower[j] = sqrt(d);
+        if (d < distA || (d == distA && j < a)) {
+          a = j;
+          distA = d;
+          upper = lower[j];
+        }
+      }
+    }
+    return a;
+  });
+  args->distances = distances;
+}
+
+/**
+ * Sums the distance from each of the thread's points to its centroid into
+ * the thread's per-cluster costs.  In the pruned modes the squared
+ * distance is also kept as the point's upper bound.
+ */
+static void costPartition(PartitionArgs *const args) {
+  int N = args->N;
+  vector<double> accum(args->K, 0.0);
+
+  for (int m = args->start; m < args->end; m++) {
+    int k = args->clusterAssignments[m];
+    double d = distSquared(&args->data[(size_t)m * N],
+                           &args->clusterCentroids[k * N], N);
+    if (args->prune)
+      args->prune->upper[m] = d;
+    accum[k] += sqrt(d);
+  }
+
+  copy(accum.begin(), accum.end(), args->cost);
+}
+
+/**
+ * Splits count points into one contiguous range per thread.  Each thread
+ * gets its own slice of sums, counts and cost.
+ */
+static void setupPartitions(vector<PartitionArgs> &args, int count, int *index,
+                            double *data, double *clusterCentroids,
+                            int *clusterAssignments, int M, int N, int K,
+                            vector<double> &sums, vector<int> &counts,
+                            vector<double> &cost) {
+  int numThreads = args.size();
+  int perThread = (count + numThreads - 1) / numThreads;
+  sums.assign((size_t)numThreads * K * N, 0.0);
+  counts.assign(numThreads * K, 0);
+  cost.assign(numThreads * K, 0.0);
+
+  for (int t = 0; t < numThreads; t++) {
+    args[t].start = min(count, t * perThread);
+    args[t].end = min(count, (t + 1) * perThread);
+    args[t].index = index;
+    args[t].data = data;
+    args[t].clusterCentroids = clusterCentroids;
+    args[t].clusterAssignments = clusterAssignments;
+    args[t].M = M;
+    args[t].N = N;
+    args[t].K = K;
+    args[t].sums = &sums[(size_t)t * K * N];
+    args[t].counts = &counts[t * K];
+    args[t].cost = &cost[t * K];
+    args[t].prune = NULL;
+    args[t].distances = 0;
+  }
+}
+
+/**
+ * Runs work on every partition, one std::thread each.  As in
+ * prog1_mandelbrot_threads, the calling thread does partition 0.
+ */
+static void runPartitions(vector<PartitionArgs> &args,
+                          void (*work)(PartitionArgs *const)) {
+  vector<thread> workers(args.size());
+  for (size_t i = 1; i < args.size(); i++) {
+    workers[i] = thread(work, &args[i]);
+  }
+  work(&args[0]);
+  for (size_t i = 1; i < args.size(); i++) {
+    workers[i].join();
+  }
+}
+
+/**
+ * Computes the K-Means algorithm on one thread with computeAssignments,
+ * computeCentroids and computeCost.  This is the reference the threaded
+ * versions are checked against.
  *
  * @param data Pointer to an array of length M*N representing the M different N 
  *     dimensional data points clustered. The data is layed out in a "data point
@@ -172,8 +516,8 @@ void computeCost(WorkerArgs *const args) {
  * @param epsilon The algorithm is said to have converged when
  *     |currCost[i] - prevCost[i]| < epsilon for all i where i = 0, 1, ..., K-1
  */
-void kMeansThread(double *data, double *clusterCentroids, int *clusterAssignments,
-               int M, int N, int K, double epsilon) {
+void kMeansSerial(double *data, double *clusterCentroids, int *clusterAssignments,
+                  int M, int N, int K, double epsilon) {
 
   // Used to track convergence
   double *prevCost = new double[K];
@@ -218,3 +562,241 @@ void kMeansThread(double *data, double *clusterCentroids, int *clusterAssignment
   free(currCost);
   free(prevCost);
 }
+
+/**
+ * Sets halfNearest and halfBetween from the current centroids.
+ */
+static void centroidSeparation(PruneState *p, double *clusterCentroids,
+                               int N, int K) {
+  for (int k = 0; k < K; k++) {
+    p->halfNearest[k] = HUGE_VAL;
+  }
+  for (int k = 0; k < K; k++) {
+    p->halfBetween[k * K + k] = 0.0;
+    for (int j = k + 1; j < K; j++) {
+      double half = 0.5 * sqrt(distSquared(&clusterCentroids[k * N],
+                                           &clusterCentroids[j * N], N));
+      p->halfBetween[k * K + j] = half;
+      p->halfBetween[j * K + k] = half;
+      p->halfNearest[k] = min(p->halfNearest[k], half);
+      p->halfNearest[j] = min(p->halfNearest[j], half);
+    }
+  }
+}
+
+/**
+ * Sets drift, farthest, maxDrift and secondDrift from how far each
+ * centroid moved between oldCentroids and clusterCentroids.
+ */
+static void centroidDrift(PruneState *p, double *oldCentroids,
+                          double *clusterCentroids, int N, int K) {
+  p->farthest = 0;
+  p->maxDrift = 0.0;
+  p->secondDrift = 0.0;
+  for (int k = 0; k < K; k++) {
+    p->drift[k] =
+        sqrt(distSquared(&oldCentroids[k * N], &clusterCentroids[k * N], N));
+    if (p->drift[k] > p->maxDrift) {
+      p->secondDrift = p->maxDrift;
+      p->maxDrift = p->drift[k];
+      p->farthest = k;
+    } else if (p->drift[k] > p->secondDrift) {
+      p->secondDrift = p->drift[k];
+    }
+  }
+}
+
+/**
+ * Computes the K-Means algorithm with the points split over numThreads
+ * std::threads (0 means one per hardware thread).  Each iteration is two
+ * parallel passes: one assigns points and sums them per centroid in every
+ * thread, the sums are merged in thread order into the new centroids, and
+ * one computes the per-cluster cost.  Distances are computed squared and
+ * vectorized.  Brute-force assignment compares them squared and only the
+ * cost takes one sqrt per point; the Hamerly and Elkan modes keep their
+ * bounds as true distances, so they take a sqrt of every distance they
+ * compute.  Other parameters are as for kMeansSerial, and the result is
+ * the same up to floating-point rounding.  mode picks how points are
+ * assigned (see AssignMode); every mode gives the same clustering.
+ *
+ * Returns the number of iterations.
+ */
+int kMeansParallel(double *data, double *clusterCentroids,
+                   int *clusterAssignments, int M, int N, int K,
+                   double epsilon, int numThreads, AssignMode mode,
+                   vector<long> *distances) {
+  if (numThreads <= 0)
+    numThreads = max(1u, thread::hardware_concurrency());
+  if (mode == ASSIGN_AUTO)
+    mode = (K < ELKAN_MIN_K) ? ASSIGN_HAMERLY : ASSIGN_ELKAN;
+
+  vector<double> prevCost(K, 1e30);
+  vector<double> currCost(K, 0.0);
+
+  vector<PartitionArgs> args(numThreads);
+  vector<double> sums, cost;
+  vector<int> counts;
+  setupPartitions(args, M, NULL, data, clusterCentroids, clusterAssignments,
+                  M, N, K, sums, counts, cost);
+
+  void (*assign)(PartitionArgs *const) = assignPartition;
+  PruneState prune;
+  vector<double> upper, lower, drift, halfNearest, halfBetween, oldCentroids;
+  if (mode != ASSIGN_BRUTE) {
+    assign = (mode == ASSIGN_HAMERLY) ? assignHamerly : assignElkan;
+    upper.resize(M);
+    lower.resize(mode == ASSIGN_HAMERLY ? M : (size_t)M * K);
+    drift.resize(K);
+    halfNearest.resize(K);
+    halfBetween.resize(K * K);
+    prune.valid = false;
+    prune.upper = upper.data();
+    prune.lower = lower.data();
+    prune.drift = drift.data();
+    prune.halfNearest = halfNearest.data();
+    prune.halfBetween = halfBetween.data();
+    for (int t = 0; t < numThreads; t++) {
+      args[t].prune = &prune;
+    }
+  }
+  if (distances)
+    distances->clear();
+
+  int iter = 0;
+  while (!stoppingConditionMet(prevCost.data(), currCost.data(), epsilon, K)) {
+    prevCost = currCost;
+
+    if (mode != ASSIGN_BRUTE) {
+      centroidSeparation(&prune, clusterCentroids, N, K);
+      oldCentroids.assign(clusterCentroids, clusterCentroids + K * N);
+    }
+
+    runPartitions(args, assign);
+    if (distances) {
+      long total = 0;
+      for (int t = 0; t < numThreads; t++) {
+        total += args[t].distances;
+      }
+      distances->push_back(total);
+    }
+
+    for (int k = 0; k < K; k++) {
+      int count = 0;
+      for (int t = 0; t < numThreads; t++) {
+        count += args[t].counts[k];
+      }
+      count = max(count, 1); // prevent divide by 0
+      for (int n = 0; n < N; n++) {
+        double sum = 0.0;
+        for (int t = 0; t < numThreads; t++) {
+          sum += args[t].sums[k * N + n];
+        }
+        clusterCentroids[k * N + n] = sum / count;
+      }
+    }
+
+    if (mode != ASSIGN_BRUTE) {
+      centroidDrift(&prune, oldCentroids.data(), clusterCentroids, N, K);
+      prune.valid = true;
+    }
+
+    runPartitions(args, costPartition);
+    for (int k = 0; k < K; k++) {
+      currCost[k] = 0.0;
+      for (int t = 0; t < numThreads; t++) {
+        currCost[k] += args[t].cost[k];
+      }
+    }
+
+    iter++;
+  }
+
+  return iter;
+}
+
+/**
+ * Computes the K-Means algorithm, using std::thread to parallelize the work.
+ * Parameters are as for kMeansSerial.
+ */
+void kMeansThread(double *data, double *clusterCentroids, int *clusterAssignments,
+               int M, int N, int K, double epsilon) {
+  kMeansParallel(data, clusterCentroids, clusterAssignments, M, N, K, epsilon,
+                 0, ASSIGN_AUTO, NULL);
+}
+
+/**
+ * Mini-batch K-means (Sculley, "Web-scale k-means clustering", WWW 2010):
+ * instead of passes over all M points, each step draws batchSize random
+ * points, assigns them in parallel and moves every centroid towards the
+ * mean of its batch points.  A centroid's step size is its batch count
+ * over the number of points it has taken in so far, so each centroid is
+ * the running mean of every point ever assigned to it and settles as the
+ * stream goes on.  Steps stop once no centroid moves more than
+ * MINIBATCH_TOLERANCE, or after MINIBATCH_MAX_PASSES * M points; a final
+ * parallel pass then assigns all M points to the resulting centroids.
+ * Other parameters are as for kMeansParallel.
+ *
+ * Returns the number of batches.
+ */
+int kMeansMiniBatch(double *data, double *clusterCentroids,
+                    int *clusterAssignments, int M, int N, int K,
+                    int batchSize, int numThreads) {
+  if (numThreads <= 0)
+    numThreads = max(1u, thread::hardware_concurrency());
+  batchSize = max(1, min(batchSize, M));
+
+  vector<int> batch(batchSize);
+  vector<long> seen(K, 0);
+  mt19937 generator(MINIBATCH_SEED);
+  uniform_int_distribution<int> pickPoint(0, M - 1);
+
+  // batch points are drawn with replacement, so several threads may hold
+  // the same point; they only add to their own sums
+  vector<PartitionArgs> args(numThreads);
+  vector<double> sums, cost;
+  vector<int> counts;
+  setupPartitions(args, batchSize, batch.data(), data, clusterCentroids, NULL,
+                  M, N, K, sums, counts, cost);
+
+  int batches = 0;
+  long maxPoints = (long)MINIBATCH_MAX_PASSES * M;
+  double maxMove;
+  do {
+    for (int b = 0; b < batchSize; b++) {
+      batch[b] = pickPoint(generator);
+    }
+    runPartitions(args, assignPartition);
+
+    maxMove = 0.0;
+    for (int k = 0; k < K; k++) {
+      int count = 0;
+      for (int t = 0; t < numThreads; t++) {
+        count += args[t].counts[k];
+      }
+      if (count == 0)
+        continue;
+      seen[k] += count;
+
+      double move = 0.0;
+      for (int n = 0; n < N; n++) {
+        double sum = 0.0;
+        for (int t = 0; t < numThreads; t++) {
+          sum += args[t].sums[k * N + n];
+        }
+        double *c = &clusterCentroids[k * N + n];
+        double step = (sum - count * *c) / seen[k];
+        *c += step;
+        move += step * step;
+      }
+      maxMove = max(maxMove, move);
+    }
+    batches++;
+  } while (maxMove > MINIBATCH_TOLERANCE * MINIBATCH_TOLERANCE &&
+           (long)batches * batchSize < maxPoints);
+
+  setupPartitions(args, M, NULL, data, clusterCentroids, clusterAssignments,
+                  M, N, K, sums, counts, cost);
+  runPartitions(args, assignPartition);
+
+  return batches;
+}
@@ -0,0 +1,55 @@
+#ifndef _KMEANS_THREAD_H
+#define _KMEANS_THREAD_H
+
+#include <vector>
+
+//
+// How kMeansParallel assigns points to centroids.  All of them give the
+// same clustering; the pruned ones keep per-point bounds from earlier
+// iterations and only compute the distances those bounds cannot rule out.
+//
+// * ASSIGN_BRUTE: every point against every centroid, M*K distances.
+// * ASSIGN_HAMERLY: one upper bound to the assigned centroid and one lower
+//   bound to all others per point (Hamerly, "Making k-means even faster",
+//   SDM 2010).  Little state, but one lower bound for all K centroids
+//   prunes less as K grows.
+// * ASSIGN_ELKAN: a lower bound per point and centroid, plus the
+//   centroid-to-centroid distances (Elkan, "Using the triangle inequality
+//   to accelerate k-means", ICML 2003).  M*K bounds, but far fewer
+//   distances at high K.
+// * ASSIGN_AUTO: Hamerly below ELKAN_MIN_K centroids, Elkan from there.
+//
+enum AssignMode {
+  ASSIGN_BRUTE,
+  ASSIGN_HAMERLY,
+  ASSIGN_ELKAN,
+  ASSIGN_AUTO,
+};
+
+#define ELKAN_MIN_K 8
+
+// The original single-threaded loop; the reference the others are checked
+// against.
+void kMeansSerial(double *data, double *clusterCentroids,
+                  int *clusterAssignments, int M, int N, int K,
+                  double epsilon);
+
+// kMeansParallel with one thread per hardware thread and ASSIGN_AUTO.
+void kMeansThread(double *data, double *clusterCentroids,
+                  int *clusterAssignments, int M, int N, int K,
+                  double epsilon);
+
+// Returns the number of iterations.  numThreads 0 means one per hardware
+// thread.  distances, if not NULL, receives the number of point-to-centroid
+// distances the assignment step computed in each iteration.
+int kMeansParallel(double *data, double *clusterCentroids,
+                   int *clusterAssignments, int M, int N, int K,
+                   double epsilon, int numThreads, AssignMode mode,
+                   std::vector<long> *distances);
+
+// Returns the number of batches.
+int kMeansMiniBatch(double *data, double *clusterCentroids,
+                    int *clusterAssignments, int M, int N, int K,
+                    int batchSize, int numThreads);
+
+#endif
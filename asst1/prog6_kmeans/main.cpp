@@ -1,22 +1,21 @@
 #include <algorithm>
+#include <getopt.h>
 #include <iostream>
 #include <math.h>
 #include <random>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 
 #include "CycleTimer.h"
+#include "kmeansThread.h"
 
 #define SEED 7
 #define SAMPLE_RATE 1e-2
 
 using namespace std;
 
-// Main compute functions
-extern void kMeansThread(double *data, double *clusterCentroids,
-                      int *clusterAssignments, int M, int N, int K,
-                      double epsilon);
 extern double dist(double *x, double *y, int nDim);
 
 // Utilities
@@ -77,9 +76,97 @@ void initCentroids(double *clusterCentroids, int K, int N) {
   }
 }
 
-int main() {
+// sum over all points of the distance to their centroid
+double totalCost(double *data, double *clusterCentroids,
+                 int *clusterAssignments, int M, int N) {
+  double cost = 0.0;
+  for (int m = 0; m < M; m++) {
+    cost += dist(&data[m * N], &clusterCentroids[clusterAssignments[m] * N], N);
+  }
+  return cost;
+}
+
+void usage(const char *progname) {
+  printf("Usage: %s [options]\n", progname);
+  printf("Program Options:\n");
+  printf("  -t  --threads <N>  Threads for the threaded versions (default: one per\n");
+  printf("                     hardware thread)\n");
+  printf("  -c  --check        Also run the original serial loop from the same start,\n");
+  printf("                     and check that it assigns every point the same way\n");
+  printf("  -b  --batch <SIZE> Also run mini-batch K-means with SIZE points per batch,\n");
+  printf("                     and compare its cost and assignments\n");
+  printf("  -a  --assign <brute|hamerly|elkan|auto>  How points are assigned: measure\n");
+  printf("                     every centroid, or skip the ones per-point bounds rule\n");
+  printf("                     out (auto: Hamerly below K=%d, else Elkan; default)\n", ELKAN_MIN_K);
+  printf("  -r  --report       Also run all three assignment modes from the same start,\n");
+  printf("                     and report their time and distances per iteration\n");
+  printf("  -?  --help         This message\n");
+}
+
+int main(int argc, char **argv) {
   srand(SEED);
 
+  int numThreads = 0;
+  bool check = false;
+  int batchSize = 0;
+  AssignMode assign = ASSIGN_AUTO;
+  bool report = false;
+
+  // parse commandline options ////////////////////////////////////////////
+  int opt;
+  static struct option long_options[] = {
+      {"threads", 1, 0, 't'},
+      {"check", 0, 0, 'c'},
+      {"batch", 1, 0, 'b'},
+      {"assign", 1, 0, 'a'},
+      {"report", 0, 0, 'r'},
+      {"help", 0, 0, '?'},
+      {0, 0, 0, 0}};
+
+  while ((opt = getopt_long(argc, argv, "t:cb:a:r?", long_options, NULL)) != EOF) {
+    switch (opt) {
+    case 't':
+      numThreads = atoi(optarg);
+      if (numThreads <= 0) {
+        printf("Error: threads must be positive\n");
+        return 1;
+      }
+      break;
+    case 'c':
+      check = true;
+      break;
+    case 'b':
+      batchSize = atoi(optarg);
+      if (batchSize <= 0) {
+        printf("Error: batch size must be positive\n");
+        return 1;
+      }
+      break;
+    case 'a':
+      if (strcmp(optarg, "brute") == 0) {
+        assign = ASSIGN_BRUTE;
+      } else if (strcmp(optarg, "hamerly") == 0) {
+        assign = ASSIGN_HAMERLY;
+      } else if (strcmp(optarg, "elkan") == 0) {
+        assign = ASSIGN_ELKAN;
+      } else if (strcmp(optarg, "auto") == 0) {
+        assign = ASSIGN_AUTO;
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'r':
+      report = true;
+      break;
+    case '?':
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  // end parsing of commandline options //////////////////////////////////////
+
   int M, N, K;
   double epsilon;
 
@@ -134,15 +221,143 @@ int main() {
   logToFile("./start.log", SAMPLE_RATE, data, clusterAssignments,
             clusterCentroids, M, N, K);
 
+  // the other versions start from the same state
+  double *startCentroids = new double[K * N];
+  int *startAssignments = new int[M];
+  memcpy(startCentroids, clusterCentroids, sizeof(double) * K * N);
+  memcpy(startAssignments, clusterAssignments, sizeof(int) * M);
+
   double startTime = CycleTimer::currentSeconds();
-  kMeansThread(data, clusterCentroids, clusterAssignments, M, N, K, epsilon);
+  int iterations = kMeansParallel(data, clusterCentroids, clusterAssignments,
+                                  M, N, K, epsilon, numThreads, assign, NULL);
   double endTime = CycleTimer::currentSeconds();
-  printf("[Total Time]: %.3f ms\n", (endTime - startTime) * 1000);
+  double threadTime = endTime - startTime;
+  printf("[Total Time]: %.3f ms\n", threadTime * 1000);
+  printf("Converged after %d iterations\n", iterations);
 
   // Log the end state of the algorithm
   logToFile("./end.log", SAMPLE_RATE, data, clusterAssignments,
             clusterCentroids, M, N, K);
 
+  double *otherCentroids = new double[K * N];
+  int *otherAssignments = new int[M];
+
+  if (check) {
+    memcpy(otherCentroids, startCentroids, sizeof(double) * K * N);
+    memcpy(otherAssignments, startAssignments, sizeof(int) * M);
+    startTime = CycleTimer::currentSeconds();
+    kMeansSerial(data, otherCentroids, otherAssignments, M, N, K, epsilon);
+    endTime = CycleTimer::currentSeconds();
+    printf("[Serial Time]: %.3f ms\t(threads %.2fx faster)\n",
+           (endTime - startTime) * 1000, (endTime - startTime) / threadTime);
+
+    int differ = 0;
+    for (int m = 0; m < M; m++) {
+      if (otherAssignments[m] != clusterAssignments[m])
+        differ++;
+    }
+    if (differ == 0) {
+      printf("Assignments match the serial loop\n");
+    } else {
+      printf("Error: %d of %d points assigned differently from the serial "
+             "loop\n", differ, M);
+    }
+  }
+
+  if (report) {
+    // brute force first; the pruned modes must match it exactly
+    const int numModes = 3;
+    const AssignMode modes[numModes] = {ASSIGN_BRUTE, ASSIGN_HAMERLY,
+                                        ASSIGN_ELKAN};
+    const char *names[numModes] = {"Brute Force", "Hamerly", "Elkan"};
+    vector<long> distances[numModes];
+    double *bruteCentroids = new double[K * N];
+    int *bruteAssignments = new int[M];
+    double bruteTime = 0.0;
+
+    for (int i = 0; i < numModes; i++) {
+      double *centroids = (i == 0) ? bruteCentroids : otherCentroids;
+      int *assignments = (i == 0) ? bruteAssignments : otherAssignments;
+      memcpy(centroids, startCentroids, sizeof(double) * K * N);
+      memcpy(assignments, startAssignments, sizeof(int) * M);
+      startTime = CycleTimer::currentSeconds();
+      kMeansParallel(data, centroids, assignments, M, N, K, epsilon,
+                     numThreads, modes[i], &distances[i]);
+      endTime = CycleTimer::currentSeconds();
+
+      long total = 0;
+      for (size_t it = 0; it < distances[i].size(); it++) {
+        total += distances[i][it];
+      }
+      if (i == 0) {
+        bruteTime = endTime - startTime;
+        printf("[%s Time]: %.3f ms\t(%ld distances)\n", names[i],
+               bruteTime * 1000, total);
+        continue;
+      }
+      printf("[%s Time]: %.3f ms\t(%.2fx speedup, %ld distances, %.2f%%)\n",
+             names[i], (endTime - startTime) * 1000,
+             bruteTime / (endTime - startTime), total,
+             100.0 * total / ((long)M * K * distances[0].size()));
+      if (distances[i].size() != distances[0].size() ||
+          memcmp(assignments, bruteAssignments, sizeof(int) * M) != 0 ||
+          memcmp(centroids, bruteCentroids, sizeof(double) * K * N) != 0) {
+        printf("Error: %s clustering differs from brute force\n", names[i]);
+      }
+    }
+
+    // every iteration for short runs, else ten rows spread over the run
+    int iters = distances[0].size();
+    int step = max(1, iters / 10);
+    printf("Distances per iteration (brute force measures M*K = %ld):\n",
+           (long)M * K);
+    printf("  %9s %12s %12s %12s\n", "iteration", "brute force", "hamerly",
+           "elkan");
+    for (int it = 0; it < iters; it++) {
+      if (it >= 10 && it % step != 0 && it != iters - 1)
+        continue;
+      printf("  %9d", it + 1);
+      for (int i = 0; i < numModes; i++) {
+        if (it < (int)distances[i].size()) {
+          printf(" %12ld", distances[i][it]);
+        } else {
+          printf(" %12s", "-");
+        }
+      }
+      printf("\n");
+    }
+
+    delete[] bruteCentroids;
+    delete[] bruteAssignments;
+  }
+
+  if (batchSize > 0) {
+    memcpy(otherCentroids, startCentroids, sizeof(double) * K * N);
+    startTime = CycleTimer::currentSeconds();
+    int batches = kMeansMiniBatch(data, otherCentroids, otherAssignments, M,
+                                  N, K, batchSize, numThreads);
+    endTime = CycleTimer::currentSeconds();
+    printf("[Mini-batch Time]: %.3f ms\t(%.2fx speedup)\n",
+           (endTime - startTime) * 1000, threadTime / (endTime - startTime));
+
+    int same = 0;
+    for (int m = 0; m < M; m++) {
+      if (otherAssignments[m] == clusterAssignments[m])
+        same++;
+    }
+    double fullCost = totalCost(data, clusterCentroids, clusterAssignments, M, N);
+    double batchCost = totalCost(data, otherCentroids, otherAssignments, M, N);
+    printf("Mini-batch: %d batches of %d, cost %.6g vs %.6g (%+.3f%%), "
+           "%.2f%% of points assigned alike\n",
+           batches, batchSize, batchCost, fullCost,
+           (batchCost - fullCost) / fullCost * 100, 100.0 * same / M);
+  }
+
+  delete[] startCentroids;
+  delete[] startAssignments;
+  delete[] otherCentroids;
+  delete[] otherAssignments;
+
   free(data);
   free(clusterCentroids);
   free(clusterAssignments);
@@ -72,13 +72,12 @@
 #endif // ISPC_USE_GCD
 #ifdef ISPC_USE_PTHREADS
   #include <pthread.h>
-  #include <semaphore.h>
+  #include <sched.h>
   #include <unistd.h>
-  #include <fcntl.h>
   #include <errno.h>
   #include <sys/types.h>
-  #include <sys/stat.h>
   #include <sys/param.h>
+  #include <atomic>
   #include <vector>
   #include <algorithm>
 #endif // ISPC_USE_PTHREADS
@@ -91,6 +90,7 @@
 #include <assert.h>
 #include <string.h>
 #include <algorithm>
+#include <vector>
 
 // Signature of ispc-generated 'task' functions
 typedef void (*TaskFuncType)(void *data, int threadIndex, int threadCount,
@@ -109,13 +109,19 @@ struct TaskInfo {
 ///////////////////////////////////////////////////////////////////////////
 // TaskGroupBase
 
+/* TaskInfo structures live in chunks that double in size: chunk k holds
+   TASK_QUEUE_CHUNK_SIZE << k entries and starts at index
+   TASK_QUEUE_CHUNK_SIZE * (2^k - 1).  That way a fixed directory of
+   MAX_TASK_QUEUE_CHUNKS pointers covers every index an int can hold, the
+   chunk for an index is found with a single bit scan, and a chunk never
+   moves once it's allocated (other threads may be reading it).
+ */
 #define LOG_TASK_QUEUE_CHUNK_SIZE 14
-#define MAX_TASK_QUEUE_CHUNKS 8
 #define TASK_QUEUE_CHUNK_SIZE (1<<LOG_TASK_QUEUE_CHUNK_SIZE)
+#define MAX_TASK_QUEUE_CHUNKS (32 - LOG_TASK_QUEUE_CHUNK_SIZE)
 
-#define MAX_LAUNCHED_TASKS (MAX_TASK_QUEUE_CHUNKS * TASK_QUEUE_CHUNK_SIZE)
-
-#define NUM_MEM_BUFFERS 16
+#define MIN_MEM_BUFFER_LOG_SIZE 12
+#define MAX_MEM_BUFFER_LOG_SIZE 30
 
 class TaskGroup;
 
@@ -140,21 +146,23 @@ protected:
     int nextTaskInfoIndex;
 
 private:
-    /* We allocate blocks of TASK_QUEUE_CHUNK_SIZE TaskInfo structures as
-       needed by the calling function.  We hold up to MAX_TASK_QUEUE_CHUNKS
-       of these (and then exit at runtime if more than this many tasks are
-       launched.)
+    /* We allocate the chunks of TaskInfo structures as needed by the
+       calling function and keep them around when the group is reset, so
+       a recycled group doesn't allocate again for launches no larger
+       than ones it has already seen.
      */
     TaskInfo *taskInfo[MAX_TASK_QUEUE_CHUNKS];
 
     /* We also allocate chunks of memory to service ISPCAlloc() calls.  The
-       memBuffers[] array holds pointers to this memory.  The first element
-       of this array is initialized to point to mem and then any subsequent
-       elements required are initialized with dynamic allocation.
+       memBuffers array holds pointers to this memory.  The first element
+       is initialized to point to mem; each later buffer is twice the size
+       of the one before it (or as large as the request that needed it),
+       and they're all reused after Reset().
      */
-    int curMemBuffer, curMemBufferOffset;
-    int memBufferSize[NUM_MEM_BUFFERS];
-    char *memBuffers[NUM_MEM_BUFFERS];
+    int curMemBuffer;
+    int64_t curMemBufferOffset;
+    std::vector<int64_t> memBufferSize;
+    std::vector<char *> memBuffers;
     char mem[256];
 };
 
@@ -164,12 +172,8 @@ inline TaskGroupBase::TaskGroupBase() {
 
     curMemBuffer = 0; 
     curMemBufferOffset = 0;
-    memBuffers[0] = mem;
-    memBufferSize[0] = sizeof(mem) / sizeof(mem[0]);
-    for (int i = 1; i < NUM_MEM_BUFFERS; ++i) {
-        memBuffers[i] = NULL;
-        memBufferSize[i] = 0;
-    }
+    memBuffers.push_back(mem);
+    memBufferSize.push_back(sizeof(mem) / sizeof(mem[0]));
 
     for (int i = 0; i < MAX_TASK_QUEUE_CHUNKS; ++i)
         taskInfo[i] = NULL;
@@ -179,8 +183,10 @@ inline TaskGroupBase::TaskGroupBase() {
 inline TaskGroupBase::~TaskGroupBase() {
     // Note: don't delete memBuffers[0], since it points to the start of
     // the "mem" member!
-    for (int i = 1; i < NUM_MEM_BUFFERS; ++i)
+    for (size_t i = 1; i < memBuffers.size(); ++i)
         delete[] memBuffers[i];
+    for (int i = 0; i < MAX_TASK_QUEUE_CHUNKS; ++i)
+        delete[] taskInfo[i];
 }
 
 
@@ -194,28 +200,38 @@ TaskGroupBase::Reset() {
 
 inline int
 TaskGroupBase::AllocTaskInfo(int count) {
+    if (count > INT32_MAX - nextTaskInfoIndex) {
+        fprintf(stderr, "Launching %d more tasks from the current function "
+                "would exceed the %d tasks a task group can index.  "
+                "Exiting.\n", count, INT32_MAX);
+        exit(1);
+    }
+
     int ret = nextTaskInfoIndex;
     nextTaskInfoIndex += count;
     return ret;
 }
 
 
+static inline int
+lLog2(uint32_t v) {
+#ifdef ISPC_IS_WINDOWS
+    unsigned long index;
+    _BitScanReverse(&index, v);
+    return (int)index;
+#else
+    return 31 - __builtin_clz(v);
+#endif // ISPC_IS_WINDOWS
+}
+
+
 inline TaskInfo *
 TaskGroupBase::GetTaskInfo(int index) {
-    int chunk = (index >> LOG_TASK_QUEUE_CHUNK_SIZE);
-    int offset = index & (TASK_QUEUE_CHUNK_SIZE-1);
-
-    if (chunk == MAX_TASK_QUEUE_CHUNKS) {
-        fprintf(stderr, "A total of %d tasks have been launched from the "
-                "current function--the simple built-in task system can handle "
-                "no more. You can increase the values of TASK_QUEUE_CHUNK_SIZE "
-                "and LOG_TASK_QUEUE_CHUNK_SIZE to work around this limitation.  "
-                "Sorry!  Exiting.\n", index);
-        exit(1);
-    }
+    int chunk = lLog2((uint32_t)(index >> LOG_TASK_QUEUE_CHUNK_SIZE) + 1);
+    int offset = index - (((1 << chunk) - 1) << LOG_TASK_QUEUE_CHUNK_SIZE);
 
     if (taskInfo[chunk] == NULL)
-        taskInfo[chunk] = new TaskInfo[TASK_QUEUE_CHUNK_SIZE];
+        taskInfo[chunk] = new TaskInfo[(size_t)TASK_QUEUE_CHUNK_SIZE << chunk];
     return &taskInfo[chunk][offset];
 }
 
@@ -223,24 +239,30 @@ TaskGroupBase::GetTaskInfo(int index) {
 inline void *
 TaskGroupBase::AllocMemory(int64_t size, int32_t alignment) {
     char *basePtr = memBuffers[curMemBuffer];
-    int64_t iptr = (int64_t)(basePtr + curMemBufferOffset);
-    iptr = (iptr + (alignment-1)) & ~(alignment-1);
+    intptr_t iptr = (intptr_t)(basePtr + curMemBufferOffset);
+    iptr = (iptr + (alignment-1)) & ~(intptr_t)(alignment-1);
 
-    int newOffset = int(iptr + size - (int64_t)basePtr);
-    if (newOffset < memBufferSize[curMemBuffer]) {
+    int64_t newOffset = (int64_t)(iptr + size - (intptr_t)basePtr);
+    if (newOffset <= memBufferSize[curMemBuffer]) {
         curMemBufferOffset = newOffset;
         return (char *)iptr;
     }
 
     ++curMemBuffer;
     curMemBufferOffset = 0;
-    assert(curMemBuffer < NUM_MEM_BUFFERS);
 
-    int allocSize = 1 << (12 + curMemBuffer);
-    allocSize = std::max(int(size+alignment), allocSize);
-    char *newBuf = new char[allocSize];
-    memBufferSize[curMemBuffer] = allocSize;
-    memBuffers[curMemBuffer] = newBuf;
+    int logSize = std::min(MIN_MEM_BUFFER_LOG_SIZE + curMemBuffer - 1,
+                           MAX_MEM_BUFFER_LOG_SIZE);
+    int64_t allocSize = std::max(size + alignment, (int64_t)1 << logSize);
+    if (curMemBuffer == (int)memBuffers.size()) {
+        memBuffers.push_back(NULL);
+        memBufferSize.push_back(0);
+    }
+    if (memBufferSize[curMemBuffer] < allocSize) {
+        delete[] memBuffers[curMemBuffer];
+        memBuffers[curMemBuffer] = new char[allocSize];
+        memBufferSize[curMemBuffer] = allocSize;
+    }
     return AllocMemory(size, alignment);
 }
 
@@ -335,20 +357,32 @@ private:
 
 #ifdef ISPC_USE_PTHREADS
 static void *lTaskEntry(void *arg);
-
+static bool lRunTaskFromQueue();
+static bool lReleaseQueuedGroup();
+
+/* Tasks are never copied into a shared queue; instead each group publishes
+   how many of its TaskInfo slots are ready (numLaunchedTasks) and threads
+   claim the next one by advancing nextTaskToRun with a compare-and-swap.
+   The counters that are hammered by other threads each get their own
+   cache line.
+ */
 class TaskGroup : public TaskGroupBase {
 public:
     TaskGroup() {
         numUnfinishedTasks = 0;
-        waitingTasks.reserve(128);
+        numLaunchedTasks = 0;
+        nextTaskToRun = 0;
+        numRefs = 0;
         inActiveList = false;
     }
 
     void Reset() {
         TaskGroupBase::Reset();
         numUnfinishedTasks = 0;
+        numLaunchedTasks = 0;
+        nextTaskToRun = 0;
         assert(inActiveList == false);
-        lMemFence();
+        assert(numRefs == 0);
     }
 
     void Launch(int baseIndex, int count);
@@ -356,11 +390,25 @@ public:
 
 private:
     friend void *lTaskEntry(void *arg);
-
-    int32_t numUnfinishedTasks;
-    int32_t pad[3];
-    std::vector<int> waitingTasks;
-    bool inActiveList;
+    friend bool lRunTaskFromQueue();
+    friend bool lReleaseQueuedGroup();
+
+    int ClaimTask();
+    int ClaimTasks(int *count);
+    bool HasWaitingTasks();
+    void RunTask(int taskNumber);
+
+    std::atomic<int32_t> nextTaskToRun;
+    char pad0[64 - sizeof(std::atomic<int32_t>)];
+    std::atomic<int32_t> numUnfinishedTasks;
+    char pad1[64 - sizeof(std::atomic<int32_t>)];
+    std::atomic<int32_t> numLaunchedTasks;
+    // Number of threads that have popped this group off the active queue
+    // and may still touch it.
+    std::atomic<int32_t> numRefs;
+    // Set while the group is in (or about to be put back in) the active
+    // queue, so that it is never queued twice.
+    std::atomic<bool> inActiveList;
 };
 
 #endif // ISPC_USE_PTHREADS
@@ -482,301 +530,459 @@ static volatile int32_t lock = 0;
 static int nThreads;
 static pthread_t *threads = NULL;
 
-static pthread_mutex_t taskSysMutex;
-static std::vector<TaskGroup *> activeTaskGroups;
-static sem_t *workerSemaphore;
+/* The active queue holds the task groups that have tasks waiting to be
+   started.  It is a bounded lock-free multi-producer/multi-consumer ring
+   (Dmitry Vyukov's array-based design): every cell carries a sequence
+   number that tells producers and consumers whether it's their turn to
+   use it, so pushing and popping each cost a single compare-and-swap on
+   the tail or head index.  A group is in the queue at most once (see
+   TaskGroup::inActiveList), so the ring only needs room for the number
+   of task groups that are live at the same time.  If it ever does fill
+   up, the group just isn't queued; its owner runs the tasks in Sync().
+ */
+#define LOG_ACTIVE_QUEUE_SIZE 10
+#define ACTIVE_QUEUE_SIZE (1<<LOG_ACTIVE_QUEUE_SIZE)
+
+struct ActiveQueueCell {
+    std::atomic<uint32_t> sequence;
+    TaskGroup *taskGroup;
+};
 
+static ActiveQueueCell activeQueue[ACTIVE_QUEUE_SIZE];
+alignas(64) static std::atomic<uint32_t> activeQueueTail;
+alignas(64) static std::atomic<uint32_t> activeQueueHead;
 
-static inline int32_t 
-lAtomicAdd(int32_t *v, int32_t delta) {
-    int32_t origValue;
-    __asm__ __volatile__("lock\n"
-                         "xaddl %0,%1"
-                         : "=r"(origValue), "=m"(*v) : "0"(delta)
-                         : "memory");
-    return origValue;
-}
+/* Worker threads are numbered 0 .. nThreads-1.  Every other thread that
+   runs tasks (the program's own threads, while they wait in Sync()) uses
+   index nThreads, so tasks always see threadIndex < threadCount. */
+static thread_local int lThreadIndex = -1;
 
+/* How many Sync() calls are active on this thread.  A task that launches
+   and syncs its own subtasks nests one level deeper each time. */
+static thread_local int lSyncDepth = 0;
 
-static void *
-lTaskEntry(void *arg) {
-    int threadIndex = (int)((int64_t)arg);
-    int threadCount = nThreads;
+/* Past this depth, a waiting thread only helps with the tasks of the
+   group it is waiting on, so that running unrelated tasks from inside
+   nested syncs can't grow the stack without bound. */
+#define MAX_HELP_DEPTH 32
+
+/* Idle workers sleep on a condition variable.  Launches only touch the
+   mutex when someone is actually asleep, and then wake everybody with a
+   single broadcast instead of posting once per task. */
+static pthread_mutex_t workerSleepMutex;
+static pthread_cond_t workerSleepCond;
+static std::atomic<int32_t> numSleepingWorkers;
 
+
+static bool
+lActiveQueuePush(TaskGroup *tg) {
+    uint32_t pos = activeQueueTail.load(std::memory_order_relaxed);
     while (1) {
-        int err;
-        //
-        // Wait on the semaphore until we're woken up due to the arrival of
-        // more work.
-        //
-        if ((err = sem_wait(workerSemaphore)) != 0) {
-            fprintf(stderr, "Error from sem_wait: %s\n", strerror(err));
-            exit(1);
+        ActiveQueueCell *cell = &activeQueue[pos & (ACTIVE_QUEUE_SIZE-1)];
+        uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (activeQueueTail.compare_exchange_weak(pos, pos + 1)) {
+                cell->taskGroup = tg;
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
         }
+        else if (diff < 0)
+            // The cell still holds an element from one lap ago: full.
+            return false;
+        else
+            pos = activeQueueTail.load(std::memory_order_relaxed);
+    }
+}
 
-        //
-        // Acquire the mutex
-        //
-        if ((err = pthread_mutex_lock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
-            exit(1);
-        }
 
-        if (activeTaskGroups.size() == 0) {
-            //
-            // Task queue is empty, go back and wait on the semaphore
-            //
-            if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-                fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-                exit(1);
+static TaskGroup *
+lActiveQueuePop() {
+    uint32_t pos = activeQueueHead.load(std::memory_order_relaxed);
+    while (1) {
+        ActiveQueueCell *cell = &activeQueue[pos & (ACTIVE_QUEUE_SIZE-1)];
+        uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - (pos + 1));
+        if (diff == 0) {
+            if (activeQueueHead.compare_exchange_weak(pos, pos + 1)) {
+                TaskGroup *tg = cell->taskGroup;
+                cell->sequence.store(pos + ACTIVE_QUEUE_SIZE,
+                                     std::memory_order_release);
+                return tg;
             }
-            continue;
         }
+        else if (diff < 0)
+            return NULL;
+        else
+            pos = activeQueueHead.load(std::memory_order_relaxed);
+    }
+}
 
-        //
-        // Get the last task group on the active list and the last task
-        // from its waiting tasks list.
-        //
-        TaskGroup *tg = activeTaskGroups.back();
-        assert(tg->waitingTasks.size() > 0);
-        int taskNumber = tg->waitingTasks.back();
-        tg->waitingTasks.pop_back();
-
-        if (tg->waitingTasks.size() == 0) {
-            // We just took the last task from this task group, so remove
-            // it from the active list.
-            activeTaskGroups.pop_back();
-            tg->inActiveList = false;
-        }
-    
-        if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-            exit(1);
-        }
 
-        //
-        // And now actually run the task
-        //
-        DBG(fprintf(stderr, "running task %d from group %p\n", taskNumber, tg));
-        TaskInfo *myTask = tg->GetTaskInfo(taskNumber);
-        myTask->func(myTask->data, threadIndex, threadCount, myTask->taskIndex,
-                     myTask->taskCount);
+static inline bool
+lActiveQueueEmpty() {
+    return activeQueueHead.load() == activeQueueTail.load();
+}
 
-        //
-        // Decrement the "number of unfinished tasks" counter in the task
-        // group.
-        //
-        lMemFence();
-        lAtomicAdd(&tg->numUnfinishedTasks, -1);
-    }
 
-    pthread_exit(NULL);
-    return 0;
+/* Put a group that has tasks waiting onto the active queue, unless it's
+   already there. */
+static inline void
+lActivateTaskGroup(TaskGroup *tg, std::atomic<bool> &inActiveList) {
+    if (inActiveList.exchange(true) == false)
+        if (!lActiveQueuePush(tg))
+            inActiveList = false;
 }
 
 
 static void
-InitTaskSystem() {
-    if (threads == NULL) {
-        while (1) {
-            if (lAtomicCompareAndSwap32(&lock, 1, 0) == 0) {
-                if (threads == NULL) {
-                    // We launch one fewer thread than there are cores,
-                    // since the main thread here will also grab jobs from
-                    // the task queue itself.
-                    nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
-
-                    int err;
-                    if ((err = pthread_mutex_init(&taskSysMutex, NULL)) != 0) {
-                        fprintf(stderr, "Error creating mutex: %s\n", strerror(err));
-                        exit(1);
-                    }
+lWakeWorkers(int count) {
+    // Pairs with the fence in lWaitForWork(): either the worker sees the
+    // group we just queued, or we see that it's asleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (numSleepingWorkers.load(std::memory_order_relaxed) == 0)
+        return;
 
-                    char name[32];
-                    sprintf(name, "ispc_task.%d", (int)getpid());
-                    workerSemaphore = sem_open(name, O_CREAT, S_IRUSR|S_IWUSR, 0);
-                    if (!workerSemaphore) {
-                        fprintf(stderr, "Error creating semaphore: %s\n", strerror(err));
-                        exit(1);
-                    }
+    int err;
+    if ((err = pthread_mutex_lock(&workerSleepMutex)) != 0) {
+        fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
+        exit(1);
+    }
+    if (count == 1)
+        err = pthread_cond_signal(&workerSleepCond);
+    else
+        err = pthread_cond_broadcast(&workerSleepCond);
+    if (err != 0) {
+        fprintf(stderr, "Error from pthread_cond_broadcast: %s\n", strerror(err));
+        exit(1);
+    }
+    if ((err = pthread_mutex_unlock(&workerSleepMutex)) != 0) {
+        fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
+        exit(1);
+    }
+}
 
-                    threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
-                    for (intptr_t i = 0; i < nThreads; ++i) {
-                        err = pthread_create(&threads[i], NULL, &lTaskEntry, (void *) i);
-                        if (err != 0) {
-                            fprintf(stderr, "Error creating pthread %lu: %s\n", i, strerror(err));
-                            exit(1);
-                        }
-                    }
 
-                    activeTaskGroups.reserve(64);
-                }
+static void
+lWaitForWork() {
+    int err;
+    if ((err = pthread_mutex_lock(&workerSleepMutex)) != 0) {
+        fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
+        exit(1);
+    }
 
-                // Make sure all of the above goes to memory before we
-                // clear the lock.
-                lMemFence();
-                lock = 0;
-                break;
-            }
+    numSleepingWorkers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (lActiveQueueEmpty())
+        if ((err = pthread_cond_wait(&workerSleepCond, &workerSleepMutex)) != 0) {
+            fprintf(stderr, "Error from pthread_cond_wait: %s\n", strerror(err));
+            exit(1);
+        }
+    numSleepingWorkers.fetch_sub(1);
+
+    if ((err = pthread_mutex_unlock(&workerSleepMutex)) != 0) {
+        fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
+        exit(1);
+    }
+}
+
+
+inline int
+TaskGroup::ClaimTask() {
+    int32_t taskNumber = nextTaskToRun.load(std::memory_order_relaxed);
+    while (taskNumber < numLaunchedTasks.load(std::memory_order_acquire))
+        if (nextTaskToRun.compare_exchange_weak(taskNumber, taskNumber + 1))
+            return taskNumber;
+    return -1;
+}
+
+
+/* Claims a run of waiting tasks at once, [first, first + *count), and
+   returns first, or -1 if none are left.  Each claim takes about half of
+   this thread's share of what is left (guided self-scheduling), so a big
+   launch costs a few trips through the active queue per thread rather than
+   one per task, while the last tasks still go out one at a time to
+   whichever thread is free.  MAX_TASK_BATCH keeps one thread from taking
+   a long run of slow tasks. */
+#define MAX_TASK_BATCH 32
+
+inline int
+TaskGroup::ClaimTasks(int *count) {
+    int32_t taskNumber = nextTaskToRun.load(std::memory_order_relaxed);
+    while (1) {
+        int32_t waiting = numLaunchedTasks.load(std::memory_order_acquire) - taskNumber;
+        if (waiting <= 0)
+            return -1;
+        int32_t n = std::min(MAX_TASK_BATCH,
+                             std::max(1, waiting / (2 * (nThreads + 1))));
+        if (nextTaskToRun.compare_exchange_weak(taskNumber, taskNumber + n)) {
+            *count = n;
+            return taskNumber;
         }
     }
 }
 
 
+inline bool
+TaskGroup::HasWaitingTasks() {
+    return nextTaskToRun.load() < numLaunchedTasks.load();
+}
+
+
 inline void
-TaskGroup::Launch(int baseCoord, int count) {
-    //
-    // Acquire mutex, add task
-    //
-    int err;
-    if ((err = pthread_mutex_lock(&taskSysMutex)) != 0) {
-        fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
-        exit(1);
+TaskGroup::RunTask(int taskNumber) {
+    DBG(fprintf(stderr, "running task %d from group %p\n", taskNumber, this));
+    TaskInfo *myTask = GetTaskInfo(taskNumber);
+    myTask->func(myTask->data, lThreadIndex, nThreads + 1, myTask->taskIndex,
+                 myTask->taskCount);
+
+    numUnfinishedTasks.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+
+/* Pop a group off the active queue and run a batch of its tasks (see
+   ClaimTasks).  Returns false if the queue was empty. */
+static bool
+lRunTaskFromQueue() {
+    TaskGroup *tg = lActiveQueuePop();
+    if (tg == NULL)
+        return false;
+
+    // We now hold the group's place in the queue (inActiveList is still
+    // set).  Claim a batch and, if there are more left, put the group
+    // straight back so that other threads can start on them while we run
+    // ours.
+    tg->numRefs.fetch_add(1);
+    int count = 0;
+    int taskNumber = tg->ClaimTasks(&count);
+    if (taskNumber >= 0 && tg->HasWaitingTasks()) {
+        if (!lActiveQueuePush(tg))
+            tg->inActiveList = false;
+    }
+    else {
+        // Give up our place, then check for tasks launched in the
+        // meantime, whose Launch() saw inActiveList still set.
+        tg->inActiveList = false;
+        if (tg->HasWaitingTasks())
+            lActivateTaskGroup(tg, tg->inActiveList);
     }
 
-    // Add the corresponding set of tasks to the waiting-to-be-run list for
-    // this task group.
-    //
-    // FIXME: it's a little ugly to hold a global mutex for this when we
-    // only need to make sure no one else is accessing this task group's
-    // waitingTasks list.  (But a small experiment in switching to a
-    // per-TaskGroup mutex showed worse performance!)
     for (int i = 0; i < count; ++i)
-        waitingTasks.push_back(baseCoord + i);
+        tg->RunTask(taskNumber + i);
+
+    tg->numRefs.fetch_sub(1, std::memory_order_release);
+    return true;
+}
 
-    // Add the task group to the global active list if it isn't there
-    // already.
-    if (inActiveList == false) {
-        activeTaskGroups.push_back(this);
-        inActiveList = true;
+
+/* Pop a group off the active queue without running any of its tasks.  A
+   group that still has tasks waiting goes back to the end of the queue;
+   one that doesn't leaves it.  Returns true if a group left the queue. */
+static bool
+lReleaseQueuedGroup() {
+    TaskGroup *tg = lActiveQueuePop();
+    if (tg == NULL)
+        return false;
+
+    tg->numRefs.fetch_add(1);
+    bool released = false;
+    if (tg->HasWaitingTasks()) {
+        if (!lActiveQueuePush(tg))
+            tg->inActiveList = false;
+    }
+    else {
+        // As in lRunTaskFromQueue(), pick up tasks launched while we
+        // still held the group's place.
+        tg->inActiveList = false;
+        if (tg->HasWaitingTasks())
+            lActivateTaskGroup(tg, tg->inActiveList);
+        released = true;
     }
+    tg->numRefs.fetch_sub(1, std::memory_order_release);
+    return released;
+}
 
-    if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-        fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-        exit(1);
+
+static void *
+lTaskEntry(void *arg) {
+    lThreadIndex = (int)((int64_t)arg);
+
+    while (1) {
+        if (!lRunTaskFromQueue())
+            lWaitForWork();
+    }
+
+    pthread_exit(NULL);
+    return 0;
+}
+
+
+static void
+lInitTaskSystem() {
+    while (1) {
+        if (lAtomicCompareAndSwap32(&lock, 1, 0) == 0) {
+            if (threads == NULL) {
+                // We launch one fewer thread than there are cores,
+                // since the main thread here will also grab jobs from
+                // the task queue itself.
+                nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+
+                for (uint32_t i = 0; i < ACTIVE_QUEUE_SIZE; ++i)
+                    activeQueue[i].sequence.store(i, std::memory_order_relaxed);
+                activeQueueHead = 0;
+                activeQueueTail = 0;
+                numSleepingWorkers = 0;
+
+                int err;
+                if ((err = pthread_mutex_init(&workerSleepMutex, NULL)) != 0) {
+                    fprintf(stderr, "Error creating mutex: %s\n", strerror(err));
+                    exit(1);
+                }
+                if ((err = pthread_cond_init(&workerSleepCond, NULL)) != 0) {
+                    fprintf(stderr, "Error creating condition variable: %s\n", strerror(err));
+                    exit(1);
+                }
+
+                threads = (pthread_t *)malloc(std::max(nThreads, 1) * sizeof(pthread_t));
+                for (intptr_t i = 0; i < nThreads; ++i) {
+                    err = pthread_create(&threads[i], NULL, &lTaskEntry, (void *) i);
+                    if (err != 0) {
+                        fprintf(stderr, "Error creating pthread %lu: %s\n", i, strerror(err));
+                        exit(1);
+                    }
+                }
+            }
+
+            // Make sure all of the above goes to memory before we
+            // clear the lock.
+            lMemFence();
+            lock = 0;
+            break;
+        }
     }
+}
+
+
+// Cheap enough to stay on the launch path for programs that never call
+// ISPCInitTaskSystem().
+static inline void
+InitTaskSystem() {
+    if (threads == NULL)
+        lInitTaskSystem();
+}
 
+
+inline void
+TaskGroup::Launch(int baseCoord, int count) {
     //
-    // Update the count of the number of tasks left to run in this task
-    // group.
+    // The TaskInfo slots [baseCoord, baseCoord+count) were filled in by
+    // ISPCLaunch(); account for them and then publish them to claimers.
+    // Only the thread that owns the group launches into it, so a plain
+    // release store is enough here.
     //
-    lMemFence();
-    lAtomicAdd(&numUnfinishedTasks, count);
+    numUnfinishedTasks.fetch_add(count, std::memory_order_relaxed);
+    assert(baseCoord == numLaunchedTasks.load(std::memory_order_relaxed));
+    numLaunchedTasks.store(baseCoord + count, std::memory_order_release);
+
+    lActivateTaskGroup(this, inActiveList);
 
     //
-    // Post to the worker semaphore to wake up worker threads that are
-    // sleeping waiting for tasks to show up
+    // Wake up worker threads that are sleeping waiting for tasks to show
+    // up--once for the whole launch, not once per task.
     //
-    for (int i = 0; i < count; ++i)
-        if ((err = sem_post(workerSemaphore)) != 0) {
-            fprintf(stderr, "Error from sem_post: %s\n", strerror(err));
-            exit(1);
-        }
+    lWakeWorkers(count);
 }
 
 
 inline void
 TaskGroup::Sync() {
-    DBG(fprintf(stderr, "syncing %p - %d unfinished\n", tg, numUnfinishedTasks));
+    DBG(fprintf(stderr, "syncing %p - %d unfinished\n", this,
+                (int)numUnfinishedTasks));
+
+    if (lThreadIndex < 0)
+        lThreadIndex = nThreads;
+    ++lSyncDepth;
 
-    while (numUnfinishedTasks > 0) {
+    //
+    // This is also how nested parallelism works: a task that launches
+    // subtasks and then syncs on them ends up here on a worker thread,
+    // which keeps running tasks instead of blocking, so the pool never
+    // loses a thread to a task waiting on its children.
+    //
+    while (numUnfinishedTasks.load(std::memory_order_acquire) > 0) {
         // All of the tasks in this group aren't finished yet.  We'll try
         // to help out here since we don't have anything else to do...
-
-        DBG(fprintf(stderr, "while syncing %p - %d unfinished\n", tg, 
-                    numUnfinishedTasks));
-
-        //
-        // Acquire the global task system mutex to grab a task to work on
-        //
-        int err;
-        if ((err = pthread_mutex_lock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_lock: %s\n", strerror(err));
-            exit(1);
+        int taskNumber = ClaimTask();
+        if (taskNumber >= 0) {
+            RunTask(taskNumber);
+            continue;
         }
 
-        TaskInfo *myTask = NULL;
-        TaskGroup *runtg = this;
-        if (waitingTasks.size() > 0) {
-            int taskNumber = waitingTasks.back();
-            waitingTasks.pop_back();
-
-            if (waitingTasks.size() == 0) {
-                // There's nothing left to start running from this group,
-                // so remove it from the active task list.
-                activeTaskGroups.erase(std::find(activeTaskGroups.begin(),
-                                                 activeTaskGroups.end(), this));
-                inActiveList = false;
-            }
-            myTask = GetTaskInfo(taskNumber);
-            DBG(fprintf(stderr, "running task %d from group %p in sync\n", taskNumber, tg));
-        }
-        else {
-            // Other threads are already working on all of the tasks in
-            // this group, so we can't help out by running one ourself.
-            // We'll try to run one from another group to make ourselves
-            // useful here.
-            if (activeTaskGroups.size() == 0) {
-                // No active task groups left--there's nothing for us to do.
-                if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-                    fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-                    exit(1);
-                }
-                // FIXME: We basically end up busy-waiting here, which is
-                // extra wasteful in a world with hyperthreading.  It would
-                // be much better to put this thread to sleep on a
-                // condition variable that was signaled when the last task
-                // in this group was finished.
-                sleep(0);
-                continue;
-            }
+        // Other threads are already working on all of the tasks in this
+        // group, so we can't help out by running one ourself.  We'll try
+        // to run one from another group to make ourselves useful here.
+        if (lSyncDepth > MAX_HELP_DEPTH || !lRunTaskFromQueue())
+            // FIXME: We basically end up busy-waiting here, which is
+            // extra wasteful in a world with hyperthreading.
+            sched_yield();
+    }
 
-            // Get a task to run from another task group.
-            runtg = activeTaskGroups.back();
-            assert(runtg->waitingTasks.size() > 0);
-
-            int taskNumber = runtg->waitingTasks.back();
-            runtg->waitingTasks.pop_back();
-            if (runtg->waitingTasks.size() == 0) {
-                // There's left to start running from this group, so remove
-                // it from the active task list.
-                activeTaskGroups.pop_back();
-                runtg->inActiveList = false;
-            }
-            myTask = runtg->GetTaskInfo(taskNumber);
-            DBG(fprintf(stderr, "running task %d from other group %p in sync\n", 
-                        taskNumber, runtg));
-        }
+    //
+    // Before the group can be recycled, it has to be out of the active
+    // queue and no other thread may still be looking at it.  Workers pop
+    // it soon enough, but we pop groups ourselves too, since with no
+    // worker threads nobody else ever will, and since workers may all be
+    // waiting here for their own groups.  Only without workers, and only
+    // within MAX_HELP_DEPTH, do we run other groups' tasks while at it;
+    // otherwise we just take finished groups off the queue, which runs
+    // nothing and so can't nest any deeper.
+    //
+    while (inActiveList.load()) {
+        bool progress;
+        if (nThreads == 0 && lSyncDepth <= MAX_HELP_DEPTH)
+            progress = lRunTaskFromQueue();
+        else
+            progress = lReleaseQueuedGroup();
+        if (!progress)
+            sched_yield();
+    }
+    while (numRefs.load(std::memory_order_acquire) > 0)
+        sched_yield();
 
-        if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
-            fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
-            exit(1);
-        }
-    
-        //
-        // Do work for _myTask_
-        //
-        // FIXME: bogus values for thread index/thread count here as well..
-        myTask->func(myTask->data, 0, 1, myTask->taskIndex, myTask->taskCount);
+    --lSyncDepth;
 
-        //
-        // Decrement the number of unfinished tasks counter
-        //
-        lMemFence();
-        lAtomicAdd(&runtg->numUnfinishedTasks, -1);
-    }
-    DBG(fprintf(stderr, "sync for %p done!n", tg));
+    DBG(fprintf(stderr, "sync for %p done!n", this));
 }
 
 #endif // ISPC_USE_PTHREADS
 
 ///////////////////////////////////////////////////////////////////////////
 
+/* Task groups are recycled through two levels of free lists.  A group is
+   always freed by the thread that allocated it (the one running the ispc
+   function that launched into it), so each thread keeps a few groups of
+   its own and the common case of launch-then-sync touches no shared
+   state at all.  Groups that don't fit in the thread's cache go to the
+   global list, which is shared with a compare-and-swap per slot.
+ */
 #define MAX_FREE_TASK_GROUPS 64
+#define TASK_GROUP_CACHE_SIZE 4
+
 static TaskGroup *freeTaskGroups[MAX_FREE_TASK_GROUPS];
 
-static inline TaskGroup *
-AllocTaskGroup() {
+struct TaskGroupCache {
+    int count;
+    TaskGroup *groups[TASK_GROUP_CACHE_SIZE];
+
+    ~TaskGroupCache();
+};
+
+static thread_local TaskGroupCache lTaskGroupCache;
+
+
+static TaskGroup *
+lAllocSharedTaskGroup() {
     for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
         TaskGroup *tg = freeTaskGroups[i];
         if (tg != NULL) {
@@ -792,10 +998,8 @@ AllocTaskGroup() {
 }
 
 
-static inline void
-FreeTaskGroup(TaskGroup *tg) {
-    tg->Reset();
-
+static void
+lFreeSharedTaskGroup(TaskGroup *tg) {
     for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
         if (freeTaskGroups[i] == NULL) {
             void *ptr = lAtomicCompareAndSwapPointer((void **)&freeTaskGroups[i], tg, NULL);
@@ -807,6 +1011,37 @@ FreeTaskGroup(TaskGroup *tg) {
     delete tg;
 }
 
+
+// Hand a thread's cached groups back when it exits.
+TaskGroupCache::~TaskGroupCache() {
+    while (count > 0)
+        lFreeSharedTaskGroup(groups[--count]);
+}
+
+
+static inline TaskGroup *
+AllocTaskGroup() {
+    TaskGroupCache &cache = lTaskGroupCache;
+    if (cache.count > 0)
+        return cache.groups[--cache.count];
+
+    return lAllocSharedTaskGroup();
+}
+
+
+static inline void
+FreeTaskGroup(TaskGroup *tg) {
+    tg->Reset();
+
+    TaskGroupCache &cache = lTaskGroupCache;
+    if (cache.count < TASK_GROUP_CACHE_SIZE) {
+        cache.groups[cache.count++] = tg;
+        return;
+    }
+
+    lFreeSharedTaskGroup(tg);
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 // ispc expects these functions to have C linkage / not be mangled
@@ -814,8 +1049,18 @@ extern "C" {
     void ISPCLaunch(void **handlePtr, void *f, void *data, int count);
     void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
     void ISPCSync(void *handle);
+    void ISPCInitTaskSystem();
+}
+
+/* Not called by ispc-generated code: programs can call this once at
+   startup so that creating the worker threads doesn't land in the first
+   (timed) launch.  Launching without calling it still works. */
+void
+ISPCInitTaskSystem() {
+    InitTaskSystem();
 }
 
+
 void
 ISPCLaunch(void **taskGroupPtr, void *func, void *data, int count) {
     TaskGroup *taskGroup;